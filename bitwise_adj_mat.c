@@ -1,14 +1,82 @@
-#include <stdio.h> /* puts */
+/* needed for mmap, pwrite and friends under -std=c99,
+ * and for memfd_create on linux
+ */
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h> /* puts, snprintf */
 #include <stdlib.h> /* calloc */
+#include <string.h> /* memcpy */
 #include <stdbool.h> /* bool */
+#include <errno.h> /* errno, EINTR, EEXIST */
+#include <fcntl.h> /* O_* */
+#include <unistd.h> /* ftruncate, pwrite, close, sysconf, getpid */
+#include <pthread.h> /* pthread_mutex_* */
+#include <sys/mman.h> /* mmap, munmap, memfd_create, shm_open */
 
 #include "bitwise_adj_mat.h"
+#include "bitwise_adj_mat_log.h"
 
 /* leaving this in place as we have some internal only helper functions
  * that we only exposed to allow for easy testing and extension
  */
 #pragma GCC diagnostic ignored "-Wmissing-prototypes"
 
+/* smallest chunk, always rounded up to a whole number of pages */
+#define BAM_COW_MIN_CHUNK (64 * 1024)
+
+/* chunks grow past BAM_COW_MIN_CHUNK to keep the number of chunks, and so
+ * the number of separate mappings, in a matrix below this
+ */
+#define BAM_COW_MAX_CHUNKS 8192
+
+/* anonymous file shared by a matrix and all of its snapshots,
+ * the file is an array of chunk sized slots
+ */
+struct bam_cow_store {
+    /* file holding the slots */
+    int fd;
+
+    /* guards everything below, snapshots may be released from any thread */
+    pthread_mutex_t lock;
+
+    /* size of each slot in bytes, a whole number of pages */
+    size_t chunk_size;
+
+    /* number of slots the file currently has room for */
+    size_t n_slots;
+
+    /* number of mapped chunks referring to each slot, n_slots of them
+     * the live matrix may read these without the lock, see bam_unshare_range
+     */
+    unsigned int *slot_refs;
+
+    /* slots no longer referred to, ready for reuse, room for n_slots */
+    size_t *free_slots;
+    size_t n_free;
+
+    /* number of matrices mapping chunks from this store */
+    unsigned int n_views;
+};
+
+/* a single matrix's view of a store */
+struct bam_cow {
+    struct bam_cow_store *store;
+
+    /* number of chunks `cells` is split into */
+    size_t n_chunks;
+
+    /* slot each chunk is mapped from, n_chunks of them */
+    size_t *slots;
+};
+
+#ifndef __linux__
+/* used to give each store a unique shm_open name */
+static unsigned int bam_cow_counter = 0;
+#endif
+
 /**********************************************
  **********************************************
  **********************************************
@@ -51,6 +119,488 @@ unsigned char * bam_access_cell(uint8_t *cells, unsigned int n_cols, unsigned in
     return &(cells[index]);
 }
 
+/* pick the chunk size for a matrix with `n_bytes` of cells */
+size_t bam_cow_pick_chunk_size(size_t n_bytes){
+    size_t chunk_size = BAM_COW_MIN_CHUNK;
+    long page_size = sysconf(_SC_PAGESIZE);
+
+    /* page sizes are powers of two, as is chunk_size */
+    while( page_size > 0 && chunk_size % (size_t) page_size ){
+        chunk_size *= 2;
+    }
+
+    while( n_bytes / chunk_size >= BAM_COW_MAX_CHUNKS ){
+        chunk_size *= 2;
+    }
+
+    return chunk_size;
+}
+
+/* open an anonymous file to hold slots
+ *
+ * returns fd on success
+ * returns -1 on error
+ */
+int bam_cow_open_file(void){
+#ifdef __linux__
+    /* not counted against the size of /dev/shm */
+    return memfd_create("bitwise_adj_mat", MFD_CLOEXEC);
+#else
+    char name[64];
+    unsigned int attempt = 0;
+    int fd = -1;
+
+    for( attempt=0; attempt < 16; ++attempt ){
+        snprintf(name, sizeof(name), "/bam_cow_%ld_%u", (long) getpid(), __atomic_add_fetch(&bam_cow_counter, 1, __ATOMIC_RELAXED));
+
+        fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if( fd >= 0 ){
+            /* only ever reached through fd */
+            shm_unlink(name);
+            return fd;
+        }
+
+        if( errno != EEXIST ){
+            return -1;
+        }
+    }
+
+    return -1;
+#endif
+}
+
+/* allocate a store with no slots
+ *
+ * returns * on success
+ * returns 0 on error
+ */
+struct bam_cow_store * bam_cow_store_new(size_t chunk_size){
+    struct bam_cow_store *store = 0;
+
+    store = calloc(1, sizeof(struct bam_cow_store));
+    if( ! store ){
+        puts("bam_cow_store_new: call to calloc failed");
+        return 0;
+    }
+
+    store->fd = bam_cow_open_file();
+    if( store->fd < 0 ){
+        puts("bam_cow_store_new: call to bam_cow_open_file failed");
+        free(store);
+        return 0;
+    }
+
+    if( pthread_mutex_init(&(store->lock), 0) ){
+        puts("bam_cow_store_new: call to pthread_mutex_init failed");
+        close(store->fd);
+        free(store);
+        return 0;
+    }
+
+    store->chunk_size = chunk_size;
+
+    return store;
+}
+
+/* free a store once nothing maps from it */
+void bam_cow_store_free(struct bam_cow_store *store){
+    close(store->fd);
+    pthread_mutex_destroy(&(store->lock));
+    free(store->slot_refs);
+    free(store->free_slots);
+    free(store);
+}
+
+/* grow the file backing `store` to `n_slots` slots, all of them free
+ * must be called with store->lock held
+ *
+ * returns 1 on success
+ * returns 0 on error
+ */
+unsigned int bam_cow_store_grow(struct bam_cow_store *store, size_t n_slots){
+    unsigned int *slot_refs = 0;
+    size_t *free_slots = 0;
+    size_t i = 0;
+
+    if( n_slots <= store->n_slots ){
+        return 1;
+    }
+
+    /* new space reads as zero */
+    if( ftruncate(store->fd, (off_t) (n_slots * store->chunk_size)) ){
+        puts("bam_cow_store_grow: call to ftruncate failed");
+        return 0;
+    }
+
+    slot_refs = realloc(store->slot_refs, n_slots * sizeof(unsigned int));
+    if( ! slot_refs ){
+        puts("bam_cow_store_grow: call to realloc failed");
+        return 0;
+    }
+    store->slot_refs = slot_refs;
+
+    free_slots = realloc(store->free_slots, n_slots * sizeof(size_t));
+    if( ! free_slots ){
+        puts("bam_cow_store_grow: call to realloc failed");
+        return 0;
+    }
+    store->free_slots = free_slots;
+
+    /* pushed highest first so they are handed out in order */
+    for( i=n_slots; i > store->n_slots; --i ){
+        slot_refs[i - 1] = 0;
+        free_slots[store->n_free++] = i - 1;
+    }
+
+    store->n_slots = n_slots;
+
+    return 1;
+}
+
+/* take a free slot with a single reference, growing the file if needed
+ * must be called with store->lock held
+ *
+ * returns 1 on success
+ * returns 0 on error
+ */
+unsigned int bam_cow_store_take_slot(struct bam_cow_store *store, size_t *slot){
+    if( ! store->n_free && ! bam_cow_store_grow(store, store->n_slots * 2 + 1) ){
+        puts("bam_cow_store_take_slot: call to bam_cow_store_grow failed");
+        return 0;
+    }
+
+    *slot = store->free_slots[--store->n_free];
+    __atomic_store_n(&(store->slot_refs[*slot]), 1, __ATOMIC_RELEASE);
+
+    return 1;
+}
+
+/* drop a reference to `slot`, it is free for reuse once none remain
+ * must be called with store->lock held
+ */
+void bam_cow_store_put_slot(struct bam_cow_store *store, size_t slot){
+    if( 0 == __atomic_sub_fetch(&(store->slot_refs[slot]), 1, __ATOMIC_ACQ_REL) ){
+        store->free_slots[store->n_free++] = slot;
+    }
+}
+
+/* allocate a view of `n_chunks` chunks on `store`
+ * the caller fills in the slots
+ *
+ * returns * on success
+ * returns 0 on error
+ */
+struct bam_cow * bam_cow_new(struct bam_cow_store *store, size_t n_chunks){
+    struct bam_cow *cow = 0;
+
+    cow = calloc(1, sizeof(struct bam_cow));
+    if( ! cow ){
+        puts("bam_cow_new: call to calloc failed");
+        return 0;
+    }
+
+    cow->slots = calloc(n_chunks, sizeof(size_t));
+    if( ! cow->slots ){
+        puts("bam_cow_new: call to calloc failed");
+        free(cow);
+        return 0;
+    }
+
+    cow->store = store;
+    cow->n_chunks = n_chunks;
+
+    return cow;
+}
+
+/* map every chunk of `cow` into a single contiguous range,
+ * runs of consecutive slots share one mapping
+ *
+ * returns * on success
+ * returns 0 on error
+ */
+uint8_t * bam_cow_map(struct bam_cow *cow, unsigned int writable){
+    size_t chunk_size = cow->store->chunk_size;
+    size_t length = cow->n_chunks * chunk_size;
+    size_t begin = 0;
+    size_t end = 0;
+    int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    uint8_t *cells = 0;
+    void *p = 0;
+
+    /* reserve the whole range, each run is then mapped over the top */
+    p = mmap(0, length, PROT_NONE, MAP_SHARED, cow->store->fd, 0);
+    if( p == MAP_FAILED ){
+        puts("bam_cow_map: call to mmap failed");
+        return 0;
+    }
+    cells = p;
+
+    for( begin=0; begin < cow->n_chunks; begin = end ){
+        for( end=begin + 1; end < cow->n_chunks && cow->slots[end] == cow->slots[end - 1] + 1; ++end ){
+        }
+
+        p = mmap(cells + begin * chunk_size, (end - begin) * chunk_size, prot, MAP_SHARED | MAP_FIXED, cow->store->fd, (off_t) (cow->slots[begin] * chunk_size));
+        if( p == MAP_FAILED ){
+            puts("bam_cow_map: call to mmap failed");
+            munmap(cells, length);
+            return 0;
+        }
+    }
+
+    return cells;
+}
+
+/* unmap `cells` (if any) and drop every reference `cow` holds,
+ * the store is freed along with its last view
+ */
+void bam_cow_release(struct bam_cow *cow, uint8_t *cells){
+    struct bam_cow_store *store = cow->store;
+    unsigned int last = 0;
+    size_t i = 0;
+
+    if( cells ){
+        munmap(cells, cow->n_chunks * store->chunk_size);
+    }
+
+    pthread_mutex_lock(&(store->lock));
+    for( i=0; i < cow->n_chunks; ++i ){
+        bam_cow_store_put_slot(store, cow->slots[i]);
+    }
+    last = (0 == --store->n_views);
+    pthread_mutex_unlock(&(store->lock));
+
+    if( last ){
+        bam_cow_store_free(store);
+    }
+
+    free(cow->slots);
+    free(cow);
+}
+
+/* allocate `n_bytes` of zeroed cells in chunks of a new store
+ * `*cow` is set to the view they are mapped through
+ *
+ * returns * on success
+ * returns 0 on error
+ */
+uint8_t * bam_cow_alloc(size_t n_bytes, struct bam_cow **cow){
+    struct bam_cow_store *store = 0;
+    size_t chunk_size = bam_cow_pick_chunk_size(n_bytes);
+    size_t n_chunks = (n_bytes + chunk_size - 1) / chunk_size;
+    uint8_t *cells = 0;
+    size_t i = 0;
+
+    store = bam_cow_store_new(chunk_size);
+    if( ! store ){
+        puts("bam_cow_alloc: call to bam_cow_store_new failed");
+        return 0;
+    }
+
+    *cow = bam_cow_new(store, n_chunks);
+    if( ! *cow ){
+        puts("bam_cow_alloc: call to bam_cow_new failed");
+        bam_cow_store_free(store);
+        return 0;
+    }
+
+    /* nobody else can see the store yet, so no need for the lock */
+    if( ! bam_cow_store_grow(store, n_chunks) ){
+        puts("bam_cow_alloc: call to bam_cow_store_grow failed");
+        bam_cow_store_free(store);
+        free((*cow)->slots);
+        free(*cow);
+        return 0;
+    }
+
+    for( i=0; i < n_chunks; ++i ){
+        bam_cow_store_take_slot(store, &((*cow)->slots[i]));
+    }
+
+    cells = bam_cow_map(*cow, 1);
+    if( ! cells ){
+        puts("bam_cow_alloc: call to bam_cow_map failed");
+        bam_cow_store_free(store);
+        free((*cow)->slots);
+        free(*cow);
+        return 0;
+    }
+
+    store->n_views = 1;
+
+    return cells;
+}
+
+/* free cells from either calloc or bam_cow_alloc */
+void bam_free_cells(uint8_t *cells, struct bam_cow *cow){
+    if( cow ){
+        bam_cow_release(cow, cells);
+    } else if( cells ){
+        free(cells);
+    }
+}
+
+/* move the calloc'd cells of `bam` into chunks so they can be shared
+ *
+ * returns 1 on success
+ * returns 0 on error
+ */
+unsigned int bam_cow_adopt(struct bitwise_adj_mat *bam){
+    size_t n_bytes = (size_t) bam->n_rows * bam->n_cols;
+    struct bam_cow *cow = 0;
+    uint8_t *cells = 0;
+
+    cells = bam_cow_alloc(n_bytes, &cow);
+    if( ! cells ){
+        puts("bam_cow_adopt: call to bam_cow_alloc failed");
+        return 0;
+    }
+
+    memcpy(cells, bam->cells, n_bytes);
+    free(bam->cells);
+
+    bam->cells = cells;
+    bam->cow = cow;
+
+    return 1;
+}
+
+/* give chunk `chunk` of `bam` a slot of its own holding the same edges,
+ * any snapshot keeps mapping the old slot
+ *
+ * returns 1 on success
+ * returns 0 on error
+ */
+unsigned int bam_cow_copy_chunk(struct bitwise_adj_mat *bam, size_t chunk){
+    struct bam_cow_store *store = bam->cow->store;
+    size_t chunk_size = store->chunk_size;
+    uint8_t *cells = bam->cells + chunk * chunk_size;
+    size_t old_slot = bam->cow->slots[chunk];
+    size_t new_slot = 0;
+    size_t done = 0;
+    ssize_t ret = 0;
+    void *p = 0;
+
+    pthread_mutex_lock(&(store->lock));
+    if( ! bam_cow_store_take_slot(store, &new_slot) ){
+        pthread_mutex_unlock(&(store->lock));
+        puts("bam_cow_copy_chunk: call to bam_cow_store_take_slot failed");
+        return 0;
+    }
+    pthread_mutex_unlock(&(store->lock));
+
+    /* copy the current contents into the new slot */
+    while( done < chunk_size ){
+        ret = pwrite(store->fd, cells + done, chunk_size - done, (off_t) (new_slot * chunk_size + done));
+        if( ret < 0 && errno == EINTR ){
+            continue;
+        }
+
+        if( ret <= 0 ){
+            puts("bam_cow_copy_chunk: call to pwrite failed");
+            pthread_mutex_lock(&(store->lock));
+            bam_cow_store_put_slot(store, new_slot);
+            pthread_mutex_unlock(&(store->lock));
+            return 0;
+        }
+
+        done += ret;
+    }
+
+    /* and map it in place of the old one */
+    p = mmap(cells, chunk_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, store->fd, (off_t) (new_slot * chunk_size));
+    if( p == MAP_FAILED ){
+        puts("bam_cow_copy_chunk: call to mmap failed");
+        /* a failed MAP_FIXED may have left a hole, put the old slot back */
+        mmap(cells, chunk_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, store->fd, (off_t) (old_slot * chunk_size));
+        pthread_mutex_lock(&(store->lock));
+        bam_cow_store_put_slot(store, new_slot);
+        pthread_mutex_unlock(&(store->lock));
+        return 0;
+    }
+
+    bam->cow->slots[chunk] = new_slot;
+
+    pthread_mutex_lock(&(store->lock));
+    bam_cow_store_put_slot(store, old_slot);
+    pthread_mutex_unlock(&(store->lock));
+
+    return 1;
+}
+
+/* get the slot chunk `chunk` of `bam` is mapped from
+ *
+ * returns slot on success
+ * returns (size_t) -1 if `bam` is not in chunks or `chunk` is out of range
+ */
+size_t bam_cow_slot(struct bitwise_adj_mat *bam, size_t chunk){
+    if( ! bam || ! bam->cow || chunk >= bam->cow->n_chunks ){
+        return (size_t) -1;
+    }
+
+    return bam->cow->slots[chunk];
+}
+
+/* drop this matrix's reference to `cells`
+ * chunks of `cells` are only freed once no other matrix is sharing them
+ *
+ * returns 1 on success
+ * returns 0 on error
+ */
+unsigned int bam_release_cells(struct bitwise_adj_mat *bam){
+    if( ! bam ){
+        puts("bam_release_cells: bam was null");
+        return 0;
+    }
+
+    bam_free_cells(bam->cells, bam->cow);
+
+    bam->cells = 0;
+    bam->cow = 0;
+
+    return 1;
+}
+
+/* ensure no snapshot is sharing the chunks holding `n_cells` cells
+ * starting at `first`, so that it is safe to write to them
+ *
+ * each shared chunk is copied, other chunks are left alone
+ *
+ * returns 1 on success
+ * returns 0 on error
+ */
+unsigned int bam_unshare_range(struct bitwise_adj_mat *bam, size_t first, size_t n_cells){
+    struct bam_cow_store *store = 0;
+    size_t chunk = 0;
+    size_t last = 0;
+
+    if( ! bam ){
+        puts("bam_unshare_range: bam was null");
+        return 0;
+    }
+
+    /* not in chunks, nothing to share */
+    if( ! bam->cow || ! n_cells ){
+        return 1;
+    }
+
+    store = bam->cow->store;
+    last = (first + n_cells - 1) / store->chunk_size;
+
+    for( chunk=first / store->chunk_size; chunk <= last; ++chunk ){
+        /* only a matrix mapping a slot can add references to it, so once
+         * this is down to our own reference it stays that way, and only
+         * this matrix ever reallocates slot_refs
+         */
+        if( __atomic_load_n(&(store->slot_refs[bam->cow->slots[chunk]]), __ATOMIC_ACQUIRE) > 1 &&
+            ! bam_cow_copy_chunk(bam, chunk) ){
+            puts("bam_unshare_range: call to bam_cow_copy_chunk failed");
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
 /* set edge representing from -> to to `value`
  * `value` must be 0 or 1
  *
@@ -66,6 +616,11 @@ unsigned int bam_set_edge(struct bitwise_adj_mat *bam, unsigned int col, unsigne
         return 0;
     }
 
+    if( bam->read_only ){
+        puts("bam_set_edge: bam is read only");
+        return 0;
+    }
+
     if( col >= bam->n_rows ){
         puts("bam_set_edge: provided column was greater than n_cells");
         return 0;
@@ -96,16 +651,33 @@ unsigned int bam_set_edge(struct bitwise_adj_mat *bam, unsigned int col, unsigne
         value = 1;
     }
 
+    /* copy on write if we are sharing this chunk with a snapshot */
+    if( ! bam_unshare_range(bam, index, 1) ){
+        puts("bam_set_edge: call to bam_unshare_range failed");
+        return 0;
+    }
+
+    /* other processes may be writing neighbouring bits of a shared memory
+     * matrix, so the read-modify-write of the cell has to be atomic
+     */
     if( value ){
         /* make a mask of all 0s with a 1 in the position we want to set */
         mask = 1 << (col % 8);
         /* set that position */
-        bam->cells[index] |= mask;
+        if( bam->mapping ){
+            __atomic_fetch_or(&(bam->cells[index]), mask, __ATOMIC_RELAXED);
+        } else {
+            bam->cells[index] |= mask;
+        }
     } else {
         /* make a mask of all 1s with a 0 in the position we want to clear */
         mask = 0xFF ^ (1 << col % 8);
         /* clear that position */
-        bam->cells[index] &= mask;
+        if( bam->mapping ){
+            __atomic_fetch_and(&(bam->cells[index]), mask, __ATOMIC_RELAXED);
+        } else {
+            bam->cells[index] &= mask;
+        }
     }
 
     return 1;
@@ -208,6 +780,10 @@ unsigned int bam_init(struct bitwise_adj_mat *bam, unsigned int num_nodes){
     bam->n_cols = 0;
     bam->n_rows = 0;
     bam->cells = 0;
+    bam->cow = 0;
+    bam->read_only = 0;
+    bam->log = 0;
+    bam->mapping = 0;
 
     /* only call bam_resize if we have a `num_nodes` > 0 */
     if( num_nodes ){
@@ -232,15 +808,25 @@ unsigned int bam_destroy(struct bitwise_adj_mat *bam, unsigned int free_bam){
         return 0;
     }
 
-    /* always free cells if defined */
-    if( bam->cells ){
-        free(bam->cells);
-        bam->cells = 0;
+    if( bam->mapping ){
+        puts("bam_destroy: bam is in shared memory, use bam_shm_detach");
+        return 0;
+    }
+
+    /* always release cells, this only frees them if no snapshot
+     * is still sharing them
+     */
+    if( ! bam_release_cells(bam) ){
+        puts("bam_destroy: call to bam_release_cells failed");
+        return 0;
     }
 
     bam->n_cols = 0;
     bam->n_rows = 0;
 
+    /* the log is owned by the caller, just forget about it */
+    bam->log = 0;
+
     /* free bam if asked nicely */
     if( free_bam ){
         free(bam);
@@ -258,6 +844,7 @@ unsigned int bam_destroy(struct bitwise_adj_mat *bam, unsigned int free_bam){
  */
 unsigned int bam_resize(struct bitwise_adj_mat *bam, unsigned int num_nodes){
     uint8_t *new_cells = 0;
+    size_t n_bytes = 0;
     unsigned int num_rows = 0;
     unsigned int num_cols = 0;
     unsigned int i = 0;
@@ -275,6 +862,22 @@ unsigned int bam_resize(struct bitwise_adj_mat *bam, unsigned int num_nodes){
         return 0;
     }
 
+    if( bam->read_only ){
+        puts("bam_resize: bam is read only");
+        return 0;
+    }
+
+    if( bam->mapping ){
+        puts("bam_resize: cannot resize a bam in shared memory");
+        return 0;
+    }
+
+    /* write ahead, dropped again below if the resize fails */
+    if( bam->log && ! bam_log_append(bam->log, BAM_LOG_RESIZE, num_nodes, 0) ){
+        puts("bam_resize: call to bam_log_append failed");
+        return 0;
+    }
+
     /* num_rows is always exactly the number of nodes */
     num_rows = num_nodes;
 
@@ -283,10 +886,16 @@ unsigned int bam_resize(struct bitwise_adj_mat *bam, unsigned int num_nodes){
      */
     num_cols = (num_nodes + 7) / 8;
 
-    /* allocate new matrix */
-    new_cells = calloc(num_cols * num_rows, sizeof(uint8_t));
+    /* allocate new matrix, it is only moved into chunks by a snapshot
+     * so that until then it stays private memory like any other
+     */
+    n_bytes = (size_t) num_cols * num_rows;
+    new_cells = calloc(n_bytes, sizeof(uint8_t));
     if( ! new_cells ){
-        puts("bam_resize: call to calloc failed");
+        puts("bam_resize: failed to allocate cells");
+        if( bam->log ){
+            bam_log_discard(bam->log);
+        }
         return 0;
     }
 
@@ -299,6 +908,10 @@ unsigned int bam_resize(struct bitwise_adj_mat *bam, unsigned int num_nodes){
                 from = bam_access_cell(bam->cells, bam->n_cols, bam->n_rows, i, j);
                 if( ! from ){
                     puts("bam_resize: copying over failed, call to bam_access_cell for from failed");
+                    free(new_cells);
+                    if( bam->log ){
+                        bam_log_discard(bam->log);
+                    }
                     return 0;
                 }
 
@@ -306,6 +919,10 @@ unsigned int bam_resize(struct bitwise_adj_mat *bam, unsigned int num_nodes){
                 to = bam_access_cell(new_cells, num_cols, num_rows, i, j);
                 if( ! to ){
                     puts("bam_resize: copying over failed, call to bam_access_cell for to failed");
+                    free(new_cells);
+                    if( bam->log ){
+                        bam_log_discard(bam->log);
+                    }
                     return 0;
                 }
 
@@ -314,8 +931,11 @@ unsigned int bam_resize(struct bitwise_adj_mat *bam, unsigned int num_nodes){
             }
         }
 
-        /* free old elements */
-        free(bam->cells);
+        /* release old elements, a snapshot may still be using them */
+        if( ! bam_release_cells(bam) ){
+            puts("bam_resize: call to bam_release_cells failed");
+            return 0;
+        }
     }
 
     /* swap */
@@ -366,9 +986,18 @@ unsigned int bam_add_edge(struct bitwise_adj_mat *bam, unsigned int from, unsign
         return 0;
     }
 
+    /* write ahead, dropped again below if the edge cannot be set */
+    if( bam->log && ! bam_log_append(bam->log, BAM_LOG_ADD, from, to) ){
+        puts("bam_add_edge: call to bam_log_append failed");
+        return 0;
+    }
+
     /* set edge to 1 (final arg) */
     if( ! bam_set_edge(bam, from, to, 1) ){
         puts("bam_add_edge: call to bam_set_edge failed");
+        if( bam->log ){
+            bam_log_discard(bam->log);
+        }
         return 0;
     }
 
@@ -402,9 +1031,18 @@ unsigned int bam_remove_edge(struct bitwise_adj_mat *bam, unsigned int from, uns
         return 0;
     }
 
+    /* write ahead, dropped again below if the edge cannot be set */
+    if( bam->log && ! bam_log_append(bam->log, BAM_LOG_REMOVE, from, to) ){
+        puts("bam_remove_edge: call to bam_log_append failed");
+        return 0;
+    }
+
     /* set edge to 0 (final arg) */
     if( ! bam_set_edge(bam, from, to, 0) ){
         puts("bam_add_edge: call to bam_set_edge failed");
+        if( bam->log ){
+            bam_log_discard(bam->log);
+        }
         return 0;
     }
 
@@ -440,4 +1078,115 @@ unsigned int bam_test_edge(struct bitwise_adj_mat *bam, unsigned int from, unsig
     return bam_get_edge(bam, from, to);
 }
 
+/* take a read only snapshot of an existing adj. matrix
+ *
+ * the first snapshot moves `cells` into chunks of an anonymous file, every
+ * snapshot then maps the same chunks and copies no edges, a later write to
+ * `bam` copies just the chunk it lands in (see bam_unshare_range) so that
+ * the snapshot continues to see the edges as they were when it was taken
+ *
+ * if no anonymous file can be made the snapshot is a full copy instead
+ *
+ * the snapshot may be read from another thread while `bam` is being
+ * mutated, calls on `bam` itself must still come from a single thread
+ *
+ * the snapshot must be released with bam_destroy(snapshot, 1)
+ *
+ * returns * on success
+ * returns 0 on error
+ */
+struct bitwise_adj_mat * bam_snapshot(struct bitwise_adj_mat *bam){
+    struct bitwise_adj_mat *snap = 0;
+    struct bam_cow_store *store = 0;
+    size_t i = 0;
+
+    if( ! bam ){
+        puts("bam_snapshot: bam was null");
+        return 0;
+    }
+
+    /* copy on write would move the live matrix out of shared memory */
+    if( bam->mapping ){
+        puts("bam_snapshot: cannot snapshot a bam in shared memory");
+        return 0;
+    }
+
+    snap = calloc(1, sizeof(struct bitwise_adj_mat));
+    if( ! snap ){
+        puts("bam_snapshot: call to calloc failed");
+        return 0;
+    }
+
+    snap->n_rows = bam->n_rows;
+    snap->n_cols = bam->n_cols;
+    snap->read_only = 1;
+
+    /* an empty matrix has no cells to share */
+    if( ! bam->cells ){
+        return snap;
+    }
+
+    /* first snapshot, move the matrix into chunks or failing that copy it */
+    if( ! bam->cow && ! bam_cow_adopt(bam) ){
+        puts("bam_snapshot: call to bam_cow_adopt failed, copying cells instead");
+        snap->cells = malloc((size_t) bam->n_rows * bam->n_cols);
+        if( ! snap->cells ){
+            puts("bam_snapshot: call to malloc failed");
+            free(snap);
+            return 0;
+        }
+        memcpy(snap->cells, bam->cells, (size_t) bam->n_rows * bam->n_cols);
+        return snap;
+    }
+
+    store = bam->cow->store;
+
+    snap->cow = bam_cow_new(store, bam->cow->n_chunks);
+    if( ! snap->cow ){
+        puts("bam_snapshot: call to bam_cow_new failed");
+        free(snap);
+        return 0;
+    }
+
+    /* map exactly the same slots, copying no edges */
+    memcpy(snap->cow->slots, bam->cow->slots, bam->cow->n_chunks * sizeof(size_t));
+
+    pthread_mutex_lock(&(store->lock));
+    for( i=0; i < snap->cow->n_chunks; ++i ){
+        __atomic_add_fetch(&(store->slot_refs[snap->cow->slots[i]]), 1, __ATOMIC_ACQ_REL);
+    }
+    ++store->n_views;
+    pthread_mutex_unlock(&(store->lock));
+
+    snap->cells = bam_cow_map(snap->cow, 0);
+    if( ! snap->cells ){
+        puts("bam_snapshot: call to bam_cow_map failed");
+        bam_cow_release(snap->cow, 0);
+        free(snap);
+        return 0;
+    }
+
+    return snap;
+}
+
+/* make sure no snapshot shares any of the `cells` of `bam`, copying every
+ * chunk a snapshot still maps, `cells` may then be written directly until
+ * the next bam_snapshot
+ *
+ * returns 1 on success
+ * returns 0 on error
+ */
+unsigned int bam_unshare_cells(struct bitwise_adj_mat *bam){
+    if( ! bam ){
+        puts("bam_unshare_cells: bam was null");
+        return 0;
+    }
+
+    if( bam->read_only ){
+        puts("bam_unshare_cells: bam is read only");
+        return 0;
+    }
+
+    return bam_unshare_range(bam, 0, (size_t) bam->n_rows * bam->n_cols);
+}
 
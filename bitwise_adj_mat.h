@@ -3,6 +3,16 @@
 
 #include <stdint.h> /* uint8_t */
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* see bitwise_adj_mat_log.h */
+struct bam_log;
+
+/* private to bitwise_adj_mat.c */
+struct bam_cow;
+
 /* this library tries to improve over the 'bitwise_adjacency_matrix` lib
  * by not wasting bits
  *
@@ -29,6 +39,35 @@ struct bitwise_adj_mat {
      * current size is n_rows * n_cols
      */
     uint8_t *cells;
+
+    /* chunks `cells` is mapped from
+     * 0 if `cells` was allocated with calloc and is owned outright
+     *
+     * `cells` is split into fixed size chunks that are shared with any
+     * snapshots taken via bam_snapshot, each chunk has its own reference
+     * count and the first write to a shared chunk copies just that chunk
+     */
+    struct bam_cow *cow;
+
+    /* 1 if this matrix is a read only snapshot, 0 otherwise
+     * all mutation of a read only matrix is an error
+     */
+    unsigned int read_only;
+
+    /* optional delta log that every add, remove and resize is recorded to
+     * 0 if mutations are not being logged
+     *
+     * see bam_log_attach in bitwise_adj_mat_log.h
+     */
+    struct bam_log *log;
+
+    /* shared memory segment `cells` lives inside of
+     * 0 if `cells` was allocated by this library
+     *
+     * a mapped matrix cannot be resized or snapshotted and must be
+     * released with bam_shm_detach, see bitwise_adj_mat_shm.h
+     */
+    void *mapping;
 };
 
 /* allocate and initialise a new adj. matrix containing `num_nodes` nodes
@@ -99,6 +138,42 @@ unsigned int bam_remove_edge(struct bitwise_adj_mat *bam, unsigned int from, uns
  */
 unsigned int bam_test_edge(struct bitwise_adj_mat *bam, unsigned int from, unsigned int to);
 
+/* take a read only snapshot of an existing adj. matrix
+ *
+ * the snapshot maps the same chunks of `cells` as `bam` so taking one
+ * copies no edges, the first write to a chunk of `bam` afterwards copies
+ * just that chunk so that the snapshot continues to see the edges as
+ * they were when it was taken, the cost of a snapshot is then in
+ * proportion to the chunks written while it is alive
+ *
+ * `cells` is moved into chunks of an anonymous shared file by the first
+ * snapshot and stays there until the next bam_resize, a child forked in
+ * that time shares the chunks with its parent rather than getting a copy,
+ * if no such file can be made the snapshot is a full copy instead
+ *
+ * the snapshot may be read from another thread while `bam` is being
+ * mutated, calls on `bam` itself must still come from a single thread
+ *
+ * the snapshot must be released with bam_destroy(snapshot, 1)
+ *
+ * returns * on success
+ * returns 0 on error
+ */
+struct bitwise_adj_mat * bam_snapshot(struct bitwise_adj_mat *bam);
+
+/* make sure no snapshot shares any of the `cells` of `bam`, copying every
+ * chunk a snapshot still maps, `cells` may then be written directly until
+ * the next bam_snapshot
+ *
+ * returns 1 on success
+ * returns 0 on error
+ */
+unsigned int bam_unshare_cells(struct bitwise_adj_mat *bam);
+
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif //BITWISE_ADJ_MAT_H
 
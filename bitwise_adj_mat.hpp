@@ -0,0 +1,512 @@
+#ifndef BITWISE_ADJ_MAT_HPP
+#define BITWISE_ADJ_MAT_HPP
+
+#include <cstddef> /* size_t, ptrdiff_t */
+#include <cstdint> /* uint8_t, uint64_t */
+#include <cstring> /* memcpy */
+#include <iterator> /* forward_iterator_tag */
+#include <new> /* bad_alloc */
+#include <stdexcept> /* invalid_argument */
+#include <utility> /* swap */
+
+#include "bitwise_adj_mat.h"
+#include "bitwise_adj_mat_log.h"
+
+/* header only C++17 wrapper around bitwise_adj_mat
+ *
+ * bam::matrix owns a bitwise_adj_mat by value, it is move only so the
+ * cells are never copied by accident, use clone() for a deep copy
+ *
+ * test and set are inline and read `cells` directly, so a probe costs
+ * the same as the hand written C, nodes must be less than size()
+ *
+ * in_neighbors(v) and out_neighbors(u) are forward ranges over node
+ * numbers for use in range-for and STL algorithms, in_neighbors walks a
+ * row 64 edges at a time but out_neighbors is a known slow path, it has
+ * to probe one byte of every row so costs O(size()) whatever the degree
+ *
+ * &, |, ^ and - (and not) between matrices of equal size build an
+ * expression object instead of a matrix, assigning it to a matrix then
+ * computes every cell in a single pass, so `d = (a & b) | c` reads each
+ * of a, b and c once and allocates no temporary matrix, with a log
+ * attached through get() every edge the assignment changes is recorded
+ *
+ * a matrix always owns private cells, matrices in shared memory (see
+ * bitwise_adj_mat_shm.h) are only supported through the C API and must
+ * not be attached through get()
+ *
+ * as with bitwise_adj_mat, row `to` bit `from` is set iff there is an edge from -> to
+ */
+
+namespace bam {
+
+class matrix;
+
+/* base of every expression, `E` is the concrete expression type
+ *
+ * an expression provides
+ *  size()          number of nodes
+ *  n_cells()       number of cells, size() rows of (size() + 7) / 8
+ *  cell(i)         value of cell `i`
+ */
+template <class E>
+struct expression {
+    const E &derived() const noexcept { return static_cast<const E &>(*this); }
+};
+
+namespace detail {
+
+/* matrices are held by reference, nested expressions by value so that an
+ * expression kept in a variable does not refer to a dead temporary
+ */
+template <class E>
+struct stored { using type = const E; };
+
+template <>
+struct stored<matrix> { using type = const matrix &; };
+
+struct op_and { static uint8_t apply(uint8_t a, uint8_t b) noexcept { return a & b; } };
+struct op_or { static uint8_t apply(uint8_t a, uint8_t b) noexcept { return a | b; } };
+struct op_xor { static uint8_t apply(uint8_t a, uint8_t b) noexcept { return a ^ b; } };
+struct op_and_not { static uint8_t apply(uint8_t a, uint8_t b) noexcept { return a & ~b; } };
+
+/* load the 8 cells starting at `p` as a little endian word */
+inline uint64_t load_word(const uint8_t *p, size_t n) noexcept {
+    uint64_t word = 0;
+    size_t i = 0;
+    for( i=0; i < n && i < 8; ++i ){
+        word |= ((uint64_t) p[i]) << (8 * i);
+    }
+    return word;
+}
+
+} /* namespace detail */
+
+/* cell wise combination of two expressions of the same size */
+template <class L, class R, class Op>
+class binary_expression : public expression<binary_expression<L, R, Op>> {
+public:
+    binary_expression(const L &l, const R &r) : l_(l), r_(r) {
+        if( l_.size() != r_.size() ){
+            throw std::invalid_argument("bam::binary_expression: matrices differ in size");
+        }
+    }
+
+    unsigned int size() const noexcept { return l_.size(); }
+    size_t n_cells() const noexcept { return l_.n_cells(); }
+    uint8_t cell(size_t i) const noexcept { return Op::apply(l_.cell(i), r_.cell(i)); }
+
+private:
+    typename detail::stored<L>::type l_;
+    typename detail::stored<R>::type r_;
+};
+
+/* forward range over every `from` with an edge from -> `to`
+ * walks row `to` a word at a time, jumping between set bits with ctz
+ */
+class in_neighbor_range {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = unsigned int;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const unsigned int *;
+        using reference = unsigned int;
+
+        iterator() noexcept = default;
+
+        iterator(const uint8_t *row, size_t n_cells, size_t cell) noexcept
+            : row_(row), n_cells_(n_cells), cell_(cell) {
+            if( cell_ < n_cells_ ){
+                word_ = detail::load_word(row_ + cell_, n_cells_ - cell_);
+                settle();
+            }
+        }
+
+        unsigned int operator*() const noexcept {
+            return (unsigned int) (cell_ * 8 + __builtin_ctzll(word_));
+        }
+
+        iterator &operator++() noexcept {
+            word_ &= word_ - 1;
+            settle();
+            return *this;
+        }
+
+        iterator operator++(int) noexcept {
+            iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const iterator &o) const noexcept { return cell_ == o.cell_ && word_ == o.word_; }
+        bool operator!=(const iterator &o) const noexcept { return ! (*this == o); }
+
+    private:
+        /* advance to the next word holding a set bit, or to the end */
+        void settle() noexcept {
+            while( ! word_ ){
+                cell_ += 8;
+                if( cell_ >= n_cells_ ){
+                    cell_ = n_cells_;
+                    return;
+                }
+                word_ = detail::load_word(row_ + cell_, n_cells_ - cell_);
+            }
+        }
+
+        const uint8_t *row_ = nullptr;
+        size_t n_cells_ = 0;
+        size_t cell_ = 0;
+        uint64_t word_ = 0;
+    };
+
+    in_neighbor_range(const uint8_t *row, size_t n_cells) noexcept : row_(row), n_cells_(n_cells) {}
+
+    iterator begin() const noexcept { return iterator(row_, n_cells_, 0); }
+    iterator end() const noexcept { return iterator(row_, n_cells_, n_cells_); }
+
+private:
+    const uint8_t *row_;
+    size_t n_cells_;
+};
+
+/* forward range over every `to` with an edge `from` -> to
+ *
+ * known slow path, successors are a column rather than a row so this
+ * tests bit `from` of each row in turn, a full walk is O(size()) byte
+ * probes one row stride apart even for a node with no edges, where that
+ * matters walk in_neighbors of a transposed matrix instead
+ */
+class out_neighbor_range {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = unsigned int;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const unsigned int *;
+        using reference = unsigned int;
+
+        iterator() noexcept = default;
+
+        iterator(const bitwise_adj_mat *bam, unsigned int from, unsigned int to) noexcept
+            : bam_(bam), from_(from), to_(to) {
+            settle();
+        }
+
+        unsigned int operator*() const noexcept { return to_; }
+
+        iterator &operator++() noexcept {
+            ++to_;
+            settle();
+            return *this;
+        }
+
+        iterator operator++(int) noexcept {
+            iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const iterator &o) const noexcept { return to_ == o.to_; }
+        bool operator!=(const iterator &o) const noexcept { return to_ != o.to_; }
+
+    private:
+        /* advance to the next row with bit `from` set, or to the end */
+        void settle() noexcept {
+            const uint8_t *cell = 0;
+            uint8_t mask = 0;
+            if( to_ >= bam_->n_rows ){
+                to_ = bam_->n_rows;
+                return;
+            }
+            cell = bam_->cells + (size_t) to_ * bam_->n_cols + from_ / 8;
+            mask = (uint8_t) (1 << (from_ % 8));
+            while( to_ < bam_->n_rows && ! (*cell & mask) ){
+                ++to_;
+                cell += bam_->n_cols;
+            }
+        }
+
+        const bitwise_adj_mat *bam_ = nullptr;
+        unsigned int from_ = 0;
+        unsigned int to_ = 0;
+    };
+
+    out_neighbor_range(const bitwise_adj_mat *bam, unsigned int from) noexcept : bam_(bam), from_(from) {}
+
+    iterator begin() const noexcept { return iterator(bam_, from_, 0); }
+    iterator end() const noexcept { return iterator(bam_, from_, bam_->n_rows); }
+
+private:
+    const bitwise_adj_mat *bam_;
+    unsigned int from_;
+};
+
+/* owning, move only wrapper around bitwise_adj_mat */
+class matrix : public expression<matrix> {
+public:
+    /* matrix with no nodes, never allocates */
+    matrix() noexcept {
+        bam_init(&bam_, 0);
+    }
+
+    /* matrix with `num_nodes` nodes and no edges
+     * throws std::bad_alloc on failure
+     */
+    explicit matrix(unsigned int num_nodes) {
+        if( ! bam_init(&bam_, num_nodes) ){
+            throw std::bad_alloc();
+        }
+    }
+
+    /* evaluate `e` into a new matrix in a single pass */
+    template <class E>
+    matrix(const expression<E> &e) : matrix(e.derived().size()) {
+        assign(e.derived());
+    }
+
+    matrix(const matrix &) = delete;
+    matrix &operator=(const matrix &) = delete;
+
+    matrix(matrix &&o) noexcept : bam_(o.bam_) {
+        bam_init(&o.bam_, 0);
+    }
+
+    matrix &operator=(matrix &&o) noexcept {
+        matrix tmp(std::move(o));
+        swap(tmp);
+        return *this;
+    }
+
+    ~matrix() {
+        bam_destroy(&bam_, 0);
+    }
+
+    /* evaluate `e` in a single pass, `e` may refer to this matrix
+     *
+     * if sizes differ this is replaced by a new matrix the size of `e`,
+     * unless a log is attached, then it is grown in place (and the growth
+     * logged) as resize would
+     *
+     * with a log attached every changed edge is appended to it, so that
+     * replaying the log reproduces the result
+     *
+     * throws std::invalid_argument if read only, or if it would have to
+     * shrink in place
+     * throws std::bad_alloc on failure, with a log attached the cells
+     * and log still agree, holding a prefix of the result
+     */
+    template <class E>
+    matrix &operator=(const expression<E> &e) {
+        const E &x = e.derived();
+        if( bam_.read_only ){
+            throw std::invalid_argument("bam::matrix: matrix is read only");
+        }
+        if( x.size() != size() ){
+            if( ! bam_.log ){
+                /* nothing but the cells to keep, so start afresh */
+                matrix tmp(x);
+                swap(tmp);
+                return *this;
+            }
+            resize(x.size());
+        }
+        /* never write through cells a snapshot still refers to */
+        if( ! bam_unshare_cells(&bam_) ){
+            throw std::bad_alloc();
+        }
+        if( bam_.log ){
+            assign_logged(x);
+        } else {
+            assign(x);
+        }
+        return *this;
+    }
+
+    template <class E>
+    matrix &operator&=(const expression<E> &e) { return *this = binary_expression<matrix, E, detail::op_and>(*this, e.derived()); }
+
+    template <class E>
+    matrix &operator|=(const expression<E> &e) { return *this = binary_expression<matrix, E, detail::op_or>(*this, e.derived()); }
+
+    template <class E>
+    matrix &operator^=(const expression<E> &e) { return *this = binary_expression<matrix, E, detail::op_xor>(*this, e.derived()); }
+
+    template <class E>
+    matrix &operator-=(const expression<E> &e) { return *this = binary_expression<matrix, E, detail::op_and_not>(*this, e.derived()); }
+
+    /* deep copy of every edge
+     * throws std::bad_alloc on failure
+     */
+    matrix clone() const {
+        matrix copy(size());
+        if( n_cells() ){
+            std::memcpy(copy.bam_.cells, bam_.cells, n_cells());
+        }
+        return copy;
+    }
+
+    /* grow to `num_nodes` nodes, keeping every existing edge
+     * throws std::invalid_argument if `num_nodes` is less than size()
+     * throws std::bad_alloc on failure
+     */
+    void resize(unsigned int num_nodes) {
+        if( num_nodes < size() ){
+            throw std::invalid_argument("bam::matrix: cannot shrink a matrix");
+        }
+        if( num_nodes == size() ){
+            return;
+        }
+        if( ! bam_resize(&bam_, num_nodes) ){
+            throw std::bad_alloc();
+        }
+    }
+
+    void swap(matrix &o) noexcept {
+        std::swap(bam_, o.bam_);
+    }
+
+    /* number of nodes */
+    unsigned int size() const noexcept { return bam_.n_rows; }
+
+    /* number of cells, used by expressions */
+    size_t n_cells() const noexcept { return (size_t) bam_.n_rows * bam_.n_cols; }
+
+    /* value of cell `i`, used by expressions */
+    uint8_t cell(size_t i) const noexcept { return bam_.cells[i]; }
+
+    /* test if an edge exists from -> to, both must be less than size() */
+    bool test(unsigned int from, unsigned int to) const noexcept {
+        return (bam_.cells[(size_t) to * bam_.n_cols + from / 8] >> (from % 8)) & 1;
+    }
+
+    /* add (or with `value` false remove) the edge from -> to,
+     * both must be less than size()
+     *
+     * a matrix with a snapshot or log attached through get() goes through
+     * bam_add_edge / bam_remove_edge so that those still see every change
+     *
+     * returns true on success
+     * returns false on failure
+     */
+    bool set(unsigned int from, unsigned int to, bool value = true) noexcept {
+        uint8_t *cell = 0;
+        uint8_t mask = 0;
+        if( shared() || bam_.log ){
+            return value ? bam_add_edge(&bam_, from, to) : bam_remove_edge(&bam_, from, to);
+        }
+        cell = bam_.cells + (size_t) to * bam_.n_cols + from / 8;
+        mask = (uint8_t) (1 << (from % 8));
+        if( value ){
+            *cell |= mask;
+        } else {
+            *cell &= (uint8_t) ~mask;
+        }
+        return true;
+    }
+
+    /* remove the edge from -> to, see set */
+    bool reset(unsigned int from, unsigned int to) noexcept {
+        return set(from, to, false);
+    }
+
+    /* every `from` with an edge from -> `to`, `to` must be less than size() */
+    in_neighbor_range in_neighbors(unsigned int to) const noexcept {
+        return in_neighbor_range(bam_.cells + (size_t) to * bam_.n_cols, bam_.n_cols);
+    }
+
+    /* every `to` with an edge `from` -> to, `from` must be less than size() */
+    out_neighbor_range out_neighbors(unsigned int from) const noexcept {
+        return out_neighbor_range(&bam_, from);
+    }
+
+    /* underlying matrix for use with the C API, it remains owned by this */
+    bitwise_adj_mat *get() noexcept { return &bam_; }
+    const bitwise_adj_mat *get() const noexcept { return &bam_; }
+
+private:
+    /* true if cells may be mapped by a snapshot, in which case a write
+     * has to go through the C API to copy the chunk it lands in
+     *
+     * only reads fields this matrix alone writes, whether a chunk really
+     * is still shared is read atomically by the C API
+     */
+    bool shared() const noexcept {
+        return bam_.read_only || bam_.cow;
+    }
+
+    /* single pass over every cell, the loop the whole expression inlines into */
+    template <class E>
+    void assign(const E &x) noexcept {
+        uint8_t *cells = bam_.cells;
+        size_t n = n_cells();
+        size_t i = 0;
+        for( i=0; i < n; ++i ){
+            cells[i] = x.cell(i);
+        }
+    }
+
+    /* as assign, appending a record to the attached log for each edge
+     * that changes, the bits of old ^ new
+     */
+    template <class E>
+    void assign_logged(const E &x) {
+        uint8_t *cells = bam_.cells;
+        size_t n = n_cells();
+        size_t i = 0;
+        for( i=0; i < n; ++i ){
+            uint8_t value = x.cell(i);
+            uint8_t diff = cells[i] ^ value;
+            unsigned int appended = 0;
+            while( diff ){
+                unsigned int bit = __builtin_ctz(diff);
+                unsigned int from = (unsigned int) ((i % bam_.n_cols) * 8 + bit);
+                unsigned int to = (unsigned int) (i / bam_.n_cols);
+                if( ! bam_log_append(bam_.log, ((value >> bit) & 1) ? BAM_LOG_ADD : BAM_LOG_REMOVE, from, to) ){
+                    /* this cell is left as it was, so drop its records */
+                    for( ; appended; --appended ){
+                        bam_log_discard(bam_.log);
+                    }
+                    throw std::bad_alloc();
+                }
+                ++appended;
+                diff &= diff - 1;
+            }
+            cells[i] = value;
+        }
+    }
+
+    bitwise_adj_mat bam_{};
+};
+
+inline void swap(matrix &a, matrix &b) noexcept {
+    a.swap(b);
+}
+
+template <class L, class R>
+binary_expression<L, R, detail::op_and> operator&(const expression<L> &l, const expression<R> &r) {
+    return binary_expression<L, R, detail::op_and>(l.derived(), r.derived());
+}
+
+template <class L, class R>
+binary_expression<L, R, detail::op_or> operator|(const expression<L> &l, const expression<R> &r) {
+    return binary_expression<L, R, detail::op_or>(l.derived(), r.derived());
+}
+
+template <class L, class R>
+binary_expression<L, R, detail::op_xor> operator^(const expression<L> &l, const expression<R> &r) {
+    return binary_expression<L, R, detail::op_xor>(l.derived(), r.derived());
+}
+
+/* edges of `l` that are not in `r` */
+template <class L, class R>
+binary_expression<L, R, detail::op_and_not> operator-(const expression<L> &l, const expression<R> &r) {
+    return binary_expression<L, R, detail::op_and_not>(l.derived(), r.derived());
+}
+
+} /* namespace bam */
+
+#endif //BITWISE_ADJ_MAT_HPP
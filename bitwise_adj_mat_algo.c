@@ -0,0 +1,1172 @@
+#include <stdio.h> /* puts */
+#include <stdlib.h> /* calloc, free */
+#include <string.h> /* memset */
+
+#include "bitwise_adj_mat.h"
+#include "bitwise_adj_mat_algo.h"
+#include "bitwise_adj_mat_shm.h"
+
+#ifdef __BMI2__
+#include <immintrin.h> /* _pext_u64 */
+#endif
+
+/* leaving this in place as we have some internal only helper functions
+ * that we only exposed to allow for easy testing and extension
+ */
+#pragma GCC diagnostic ignored "-Wmissing-prototypes"
+
+/* bulk phases are parallelised when built with -fopenmp */
+#ifdef _OPENMP
+#define BAM_PARALLEL_FOR _Pragma("omp parallel for schedule(static)")
+#else
+#define BAM_PARALLEL_FOR
+#endif
+
+/* marks a node not yet visited */
+#define BAM_UNVISITED UINT32_MAX
+
+/* arguments for bam_algo_rows_kernel and bam_algo_transpose_kernel */
+struct bam_algo_unpack_work {
+    uint64_t *out;
+    unsigned int words;
+};
+
+/* arguments for bam_algo_hops_kernel */
+struct bam_algo_hops_work {
+    const uint64_t *frontier;
+    const uint64_t *reach;
+    uint64_t *next;
+};
+
+/* arguments for bam_algo_khop_kernel */
+struct bam_algo_khop_work {
+    const uint64_t *frontier;
+    const uint64_t *reached;
+    uint64_t *next;
+
+    /* index of each non-zero word of frontier */
+    const unsigned int *active;
+    unsigned int n_active;
+};
+
+/* arguments for bam_algo_gather_kernel and bam_algo_compact_kernel */
+struct bam_algo_subgraph_work {
+    struct bitwise_adj_mat *dst;
+    const uint32_t *nodes;
+    size_t k;
+    const uint64_t *mask;
+    unsigned int words;
+};
+
+/**********************************************
+ **********************************************
+ **********************************************
+ ******** simple helper functions *************
+ **********************************************
+ **********************************************
+ ***********************************************/
+
+/* number of uint64_t words needed to hold one bit per node */
+unsigned int bam_algo_words(unsigned int n_nodes){
+    return (n_nodes + 63) / 64;
+}
+
+/* load word `word` (64 columns) of a row of `n_cols` cells */
+uint64_t bam_algo_load_word(const uint8_t *row, unsigned int n_cols, unsigned int word){
+    uint64_t bits = 0;
+    unsigned int col = word * 8;
+    unsigned int i = 0;
+
+    for( i=0; i < 8 && col + i < n_cols; ++i ){
+        bits |= ((uint64_t) row[col + i]) << (8 * i);
+    }
+
+    return bits;
+}
+
+/* run `fn` over every row of `bam`
+ *
+ * a matrix in shared memory partitioned with BAM_NUMA_PARTITION is handed
+ * to bam_numa_run, so `fn` is called once per NUMA node from a thread bound
+ * to that node with just the rows whose cells live there, any other matrix
+ * gets a single call covering every row
+ *
+ * `fn` spreads its range over threads with BAM_PARALLEL_FOR, those threads
+ * inherit the node binding of the thread that started them
+ *
+ * returns 1 on success
+ * returns 0 on error
+ */
+unsigned int bam_algo_for_rows(struct bitwise_adj_mat *bam, void (*fn)(struct bitwise_adj_mat *bam, unsigned int begin, unsigned int end, void *arg), void *arg){
+    if( bam->mapping && bam_shm_numa_policy(bam) == BAM_NUMA_PARTITION ){
+        return bam_numa_run(bam, fn, arg);
+    }
+
+    fn(bam, 0, bam->n_rows, arg);
+
+    return 1;
+}
+
+/* unpack rows [begin, end) of `bam`, see bam_algo_rows */
+void bam_algo_rows_kernel(struct bitwise_adj_mat *bam, unsigned int begin, unsigned int end, void *arg){
+    struct bam_algo_unpack_work *work = arg;
+    unsigned int row = 0;
+
+    BAM_PARALLEL_FOR
+    for( row=begin; row < end; ++row ){
+        const uint8_t *cells = &(bam->cells[(size_t) row * bam->n_cols]);
+        unsigned int col = 0;
+
+        for( col=0; col < bam->n_cols; ++col ){
+            work->out[(size_t) row * work->words + col / 8] |= ((uint64_t) cells[col]) << (8 * (col % 8));
+        }
+    }
+}
+
+/* transpose rows [begin, end) of `bam`, see bam_algo_transpose */
+void bam_algo_transpose_kernel(struct bitwise_adj_mat *bam, unsigned int begin, unsigned int end, void *arg){
+    struct bam_algo_unpack_work *work = arg;
+    /* rows of another NUMA node may share words of `out` with ours */
+    unsigned int shared = begin || end < bam->n_rows;
+    unsigned int block = 0;
+
+    /* gather, each block of 64 `from` nodes owns its 64 output rows so
+     * blocks run in parallel without sharing a word, and between them
+     * they still make one pass over cells plus one op per edge
+     */
+    BAM_PARALLEL_FOR
+    for( block=0; block < work->words; ++block ){
+        unsigned int to = 0;
+
+        for( to=begin; to < end; ++to ){
+            uint64_t bits = bam_algo_load_word(&(bam->cells[(size_t) to * bam->n_cols]), bam->n_cols, block);
+
+            while( bits ){
+                uint64_t *out = &(work->out[(size_t) (block * 64 + __builtin_ctzll(bits)) * work->words + to / 64]);
+                uint64_t bit = ((uint64_t) 1) << (to % 64);
+
+                if( shared ){
+                    __atomic_fetch_or(out, bit, __ATOMIC_RELAXED);
+                } else {
+                    *out |= bit;
+                }
+
+                /* clear lowest set bit */
+                bits &= bits - 1;
+            }
+        }
+    }
+}
+
+/* pull rows [begin, end) of `bam` one hop on, see bam_algo_hops */
+void bam_algo_hops_kernel(struct bitwise_adj_mat *bam, unsigned int begin, unsigned int end, void *arg){
+    struct bam_algo_hops_work *work = arg;
+    unsigned int v = 0;
+
+    /* a node gains every source that reached one of its predecessors
+     * in the last step, 64 sources per OR
+     */
+    BAM_PARALLEL_FOR
+    for( v=begin; v < end; ++v ){
+        const uint8_t *row = &(bam->cells[(size_t) v * bam->n_cols]);
+        uint64_t acc = 0;
+        unsigned int col = 0;
+        uint8_t cell = 0;
+
+        for( col=0; col < bam->n_cols; ++col ){
+            cell = row[col];
+            while( cell ){
+                acc |= work->frontier[col * 8 + __builtin_ctz(cell)];
+                cell &= cell - 1;
+            }
+        }
+
+        work->next[v] = acc & ~work->reach[v];
+    }
+}
+
+/* pull rows [begin, end) of `bam` one hop on, see bam_khop */
+void bam_algo_khop_kernel(struct bitwise_adj_mat *bam, unsigned int begin, unsigned int end, void *arg){
+    struct bam_algo_khop_work *work = arg;
+    unsigned int v = 0;
+
+    /* pull, v is next if its row (predecessors) meets the frontier,
+     * only the words of the row under a non-zero frontier word are read
+     */
+    BAM_PARALLEL_FOR
+    for( v=begin; v < end; ++v ){
+        const uint8_t *row = &(bam->cells[(size_t) v * bam->n_cols]);
+        unsigned int i = 0;
+        unsigned int w = 0;
+
+        if( (work->reached[v / 64] >> (v % 64)) & 1 ){
+            continue;
+        }
+
+        for( i=0; i < work->n_active; ++i ){
+            w = work->active[i];
+            if( bam_algo_load_word(row, bam->n_cols, w) & work->frontier[w] ){
+                /* words of next are shared between threads, and between
+                 * the per node threads of bam_numa_run even without OpenMP
+                 */
+                __atomic_fetch_or(&(work->next[v / 64]), ((uint64_t) 1) << (v % 64), __ATOMIC_RELAXED);
+                break;
+            }
+        }
+    }
+}
+
+/* unpack the rows of `bam` into `words` uint64_t per row
+ *
+ * row `to` bit `from` is set iff there is an edge from -> to,
+ * so each row is the set of predecessors of that node
+ *
+ * returns * on success, to be freed by the caller
+ * returns 0 on error
+ */
+uint64_t * bam_algo_rows(struct bitwise_adj_mat *bam, unsigned int words){
+    struct bam_algo_unpack_work work;
+
+    work.words = words;
+    work.out = calloc((size_t) bam->n_rows * words, sizeof(uint64_t));
+    if( ! work.out ){
+        puts("bam_algo_rows: call to calloc failed");
+        return 0;
+    }
+
+    if( ! bam_algo_for_rows(bam, bam_algo_rows_kernel, &work) ){
+        puts("bam_algo_rows: call to bam_algo_for_rows failed");
+        free(work.out);
+        return 0;
+    }
+
+    return work.out;
+}
+
+/* transpose the rows of `bam` into `words` uint64_t per row
+ *
+ * row `from` bit `to` is set iff there is an edge from -> to,
+ * so each row is the set of successors of that node
+ *
+ * returns * on success, to be freed by the caller
+ * returns 0 on error
+ */
+uint64_t * bam_algo_transpose(struct bitwise_adj_mat *bam, unsigned int words){
+    struct bam_algo_unpack_work work;
+
+    work.words = words;
+    work.out = calloc((size_t) bam->n_rows * words, sizeof(uint64_t));
+    if( ! work.out ){
+        puts("bam_algo_transpose: call to calloc failed");
+        return 0;
+    }
+
+    if( ! bam_algo_for_rows(bam, bam_algo_transpose_kernel, &work) ){
+        puts("bam_algo_transpose: call to bam_algo_for_rows failed");
+        free(work.out);
+        return 0;
+    }
+
+    return work.out;
+}
+
+/* find the first set bit at or after `pos` within the `words` words of `set`
+ *
+ * returns index of bit if found
+ * returns words * 64 if there is no such bit
+ */
+unsigned int bam_algo_next_bit(const uint64_t *set, unsigned int words, unsigned int pos){
+    unsigned int word = pos / 64;
+    uint64_t bits = 0;
+
+    if( word >= words ){
+        return words * 64;
+    }
+
+    /* ignore bits before pos in the first word */
+    bits = set[word] & (~((uint64_t) 0) << (pos % 64));
+
+    while( ! bits ){
+        ++word;
+        if( word >= words ){
+            return words * 64;
+        }
+        bits = set[word];
+    }
+
+    return word * 64 + __builtin_ctzll(bits);
+}
+
+/* gather the bits of `bits` selected by `mask` into the low bits of the result,
+ * keeping their order
+ */
+uint64_t bam_algo_pext(uint64_t bits, uint64_t mask){
+#ifdef __BMI2__
+    return _pext_u64(bits, mask);
+#else
+    uint64_t out = 0;
+    unsigned int i = 0;
+
+    /* walk the set bits of mask, lowest first */
+    for( i=0; mask; ++i ){
+        if( bits & mask & (~mask + 1) ){
+            out |= ((uint64_t) 1) << i;
+        }
+        mask &= mask - 1;
+    }
+
+    return out;
+#endif
+}
+
+/* OR the low `count` bits of `bits` into `row` starting at bit `pos`
+ * `bits` must have no set bits above `count`
+ */
+void bam_algo_append_bits(uint8_t *row, size_t pos, uint64_t bits, unsigned int count){
+    unsigned int taken = 0;
+
+    while( count ){
+        row[pos / 8] |= (uint8_t) (bits << (pos % 8));
+
+        taken = 8 - (pos % 8);
+        if( taken > count ){
+            taken = count;
+        }
+
+        bits >>= taken;
+        pos += taken;
+        count -= taken;
+    }
+}
+
+/* advance the `n_srcs` sources in `srcs` up to `k` hops together,
+ * bit `i` of each node's word standing for `srcs[i]`
+ *
+ * `reach` must have room for bam->n_rows words and on success
+ * bit `i` of `reach[node]` is set iff `node` is within `k` hops of `srcs[i]`
+ *
+ * if `dist` is non-0 then `dist[i * bam->n_rows + node]` is set to the
+ * number of hops from `srcs[i]` to `node` for every node reached
+ *
+ * returns 1 on success
+ * returns 0 on error
+ */
+unsigned int bam_algo_hops(struct bitwise_adj_mat *bam, const uint32_t *srcs, unsigned int n_srcs, unsigned int k, uint64_t *reach, uint8_t *dist){
+    unsigned int n = bam->n_rows;
+    struct bam_algo_hops_work work;
+    uint64_t *frontier = 0;
+    uint64_t *next = 0;
+    uint64_t any = 0;
+    unsigned int level = 0;
+    unsigned int v = 0;
+    unsigned int i = 0;
+
+    frontier = calloc(n, sizeof(uint64_t));
+    next = calloc(n, sizeof(uint64_t));
+    if( ! frontier || ! next ){
+        puts("bam_algo_hops: call to calloc failed");
+        free(frontier);
+        free(next);
+        return 0;
+    }
+
+    memset(reach, 0, n * sizeof(uint64_t));
+
+    for( i=0; i < n_srcs; ++i ){
+        reach[srcs[i]] |= ((uint64_t) 1) << i;
+        frontier[srcs[i]] |= ((uint64_t) 1) << i;
+        if( dist ){
+            dist[(size_t) i * n + srcs[i]] = 0;
+        }
+    }
+
+    work.frontier = frontier;
+    work.reach = reach;
+    work.next = next;
+
+    for( level=1; level <= k; ++level ){
+        if( ! bam_algo_for_rows(bam, bam_algo_hops_kernel, &work) ){
+            puts("bam_algo_hops: call to bam_algo_for_rows failed");
+            free(frontier);
+            free(next);
+            return 0;
+        }
+
+        any = 0;
+        for( v=0; v < n; ++v ){
+            frontier[v] = next[v];
+            reach[v] |= next[v];
+            any |= next[v];
+
+            if( dist ){
+                uint64_t lanes = next[v];
+                while( lanes ){
+                    dist[(size_t) __builtin_ctzll(lanes) * n + v] = level;
+                    lanes &= lanes - 1;
+                }
+            }
+        }
+
+        /* nothing new, further hops cannot reach anything either */
+        if( ! any ){
+            break;
+        }
+    }
+
+    free(frontier);
+    free(next);
+
+    return 1;
+}
+
+
+/**********************************************
+ **********************************************
+ **********************************************
+ ******** bitwise_adj_mat_algo.h implementation
+ **********************************************
+ **********************************************
+ ***********************************************/
+
+/* find the strongly connected components of `bam`
+ *
+ * `component_out` must have room for bam_size(bam) entries,
+ * on success `component_out[node]` is the component `node` belongs to
+ *
+ * components are numbered in topological order of the condensation,
+ * so for every edge from -> to, component_out[from] <= component_out[to]
+ *
+ * returns number of components on success (which may be 0)
+ * returns 0 on error
+ */
+unsigned int bam_scc(struct bitwise_adj_mat *bam, uint32_t *component_out){
+    unsigned int n = 0;
+    unsigned int words = 0;
+    uint64_t *succ = 0;
+    /* per node tarjan state */
+    uint32_t *index = 0;
+    uint32_t *low = 0;
+    uint32_t *cursor = 0;
+    uint8_t *on_stack = 0;
+    /* tarjan's stack of visited nodes */
+    uint32_t *stack = 0;
+    unsigned int n_stack = 0;
+    /* explicit call stack replacing recursion */
+    uint32_t *calls = 0;
+    unsigned int n_calls = 0;
+    unsigned int counter = 0;
+    unsigned int n_components = 0;
+    unsigned int root = 0;
+    unsigned int v = 0;
+    unsigned int w = 0;
+
+    if( ! bam ){
+        puts("bam_scc: bam was null");
+        return 0;
+    }
+
+    if( ! component_out ){
+        puts("bam_scc: component_out was null");
+        return 0;
+    }
+
+    n = bam->n_rows;
+    if( ! n ){
+        return 0;
+    }
+
+    words = bam_algo_words(n);
+
+    succ = bam_algo_transpose(bam, words);
+    index = malloc(n * sizeof(uint32_t));
+    low = malloc(n * sizeof(uint32_t));
+    cursor = calloc(n, sizeof(uint32_t));
+    on_stack = calloc(n, sizeof(uint8_t));
+    stack = malloc(n * sizeof(uint32_t));
+    calls = malloc(n * sizeof(uint32_t));
+
+    if( ! succ || ! index || ! low || ! cursor || ! on_stack || ! stack || ! calls ){
+        puts("bam_scc: allocation failed");
+        free(succ);
+        free(index);
+        free(low);
+        free(cursor);
+        free(on_stack);
+        free(stack);
+        free(calls);
+        return 0;
+    }
+
+    for( v=0; v < n; ++v ){
+        index[v] = BAM_UNVISITED;
+    }
+
+    for( root=0; root < n; ++root ){
+        if( index[root] != BAM_UNVISITED ){
+            continue;
+        }
+
+        /* visit root */
+        index[root] = low[root] = counter++;
+        stack[n_stack++] = root;
+        on_stack[root] = 1;
+        calls[n_calls++] = root;
+
+        while( n_calls ){
+            v = calls[n_calls - 1];
+
+            /* resume scanning successors of v where we left off */
+            w = bam_algo_next_bit(&(succ[(size_t) v * words]), words, cursor[v]);
+
+            if( w < n ){
+                cursor[v] = w + 1;
+
+                if( index[w] == BAM_UNVISITED ){
+                    /* visit w */
+                    index[w] = low[w] = counter++;
+                    stack[n_stack++] = w;
+                    on_stack[w] = 1;
+                    calls[n_calls++] = w;
+                } else if( on_stack[w] && index[w] < low[v] ){
+                    low[v] = index[w];
+                }
+
+                continue;
+            }
+
+            /* all successors of v done, return to caller */
+            --n_calls;
+            if( n_calls ){
+                w = calls[n_calls - 1];
+                if( low[v] < low[w] ){
+                    low[w] = low[v];
+                }
+            }
+
+            /* v is the root of a component, pop it off */
+            if( low[v] == index[v] ){
+                do {
+                    w = stack[--n_stack];
+                    on_stack[w] = 0;
+                    component_out[w] = n_components;
+                } while( w != v );
+
+                ++n_components;
+            }
+        }
+    }
+
+    /* tarjan completes components in reverse topological order */
+    BAM_PARALLEL_FOR
+    for( v=0; v < n; ++v ){
+        component_out[v] = n_components - 1 - component_out[v];
+    }
+
+    free(succ);
+    free(index);
+    free(low);
+    free(cursor);
+    free(on_stack);
+    free(stack);
+    free(calls);
+
+    return n_components;
+}
+
+/* find a topological order of the nodes in `bam`
+ *
+ * `order_out` must have room for bam_size(bam) entries,
+ * on success for every edge from -> to, `from` appears before `to`
+ *
+ * returns 1 on success
+ * returns 0 on failure, including if `bam` contains a cycle
+ */
+unsigned int bam_toposort(struct bitwise_adj_mat *bam, uint32_t *order_out){
+    unsigned int n = 0;
+    unsigned int words = 0;
+    uint64_t *pred = 0;
+    uint64_t *succ = 0;
+    uint32_t *in_degree = 0;
+    unsigned int head = 0;
+    unsigned int tail = 0;
+    unsigned int v = 0;
+    unsigned int w = 0;
+
+    if( ! bam ){
+        puts("bam_toposort: bam was null");
+        return 0;
+    }
+
+    if( ! order_out ){
+        puts("bam_toposort: order_out was null");
+        return 0;
+    }
+
+    n = bam->n_rows;
+    if( ! n ){
+        return 1;
+    }
+
+    words = bam_algo_words(n);
+
+    pred = bam_algo_rows(bam, words);
+    succ = bam_algo_transpose(bam, words);
+    in_degree = malloc(n * sizeof(uint32_t));
+
+    if( ! pred || ! succ || ! in_degree ){
+        puts("bam_toposort: allocation failed");
+        free(pred);
+        free(succ);
+        free(in_degree);
+        return 0;
+    }
+
+    /* in degree is the population count of each row */
+    BAM_PARALLEL_FOR
+    for( v=0; v < n; ++v ){
+        unsigned int degree = 0;
+        unsigned int i = 0;
+
+        for( i=0; i < words; ++i ){
+            degree += __builtin_popcountll(pred[(size_t) v * words + i]);
+        }
+        in_degree[v] = degree;
+    }
+
+    free(pred);
+
+    /* order_out doubles as kahn's queue */
+    for( v=0; v < n; ++v ){
+        if( ! in_degree[v] ){
+            order_out[tail++] = v;
+        }
+    }
+
+    while( head < tail ){
+        v = order_out[head++];
+
+        for( w = bam_algo_next_bit(&(succ[(size_t) v * words]), words, 0);
+             w < n;
+             w = bam_algo_next_bit(&(succ[(size_t) v * words]), words, w + 1) ){
+            if( 0 == --in_degree[w] ){
+                order_out[tail++] = w;
+            }
+        }
+    }
+
+    free(succ);
+    free(in_degree);
+
+    if( tail != n ){
+        puts("bam_toposort: graph contains a cycle");
+        return 0;
+    }
+
+    return 1;
+}
+
+/* find the weakly connected components of `bam`,
+ * that is the components when the direction of edges is ignored
+ *
+ * `labels` must have room for bam_size(bam) entries,
+ * on success `labels[node]` is the component `node` belongs to
+ *
+ * components are numbered in order of their lowest numbered node
+ *
+ * returns number of components on success (which may be 0)
+ * returns 0 on error
+ */
+unsigned int bam_connected_components(struct bitwise_adj_mat *bam, uint32_t *labels){
+    unsigned int n = 0;
+    unsigned int words = 0;
+    /* neighbours in either direction, row | column */
+    uint64_t *sym = 0;
+    uint64_t *succ = 0;
+    /* every node already assigned a component */
+    uint64_t *visited = 0;
+    /* nodes newly reached in the last step */
+    uint64_t *frontier = 0;
+    uint32_t *members = 0;
+    unsigned int n_members = 0;
+    unsigned int n_components = 0;
+    unsigned int seed = 0;
+    unsigned int v = 0;
+    unsigned int w = 0;
+    unsigned int grew = 0;
+    size_t i = 0;
+
+    if( ! bam ){
+        puts("bam_connected_components: bam was null");
+        return 0;
+    }
+
+    if( ! labels ){
+        puts("bam_connected_components: labels was null");
+        return 0;
+    }
+
+    n = bam->n_rows;
+    if( ! n ){
+        return 0;
+    }
+
+    words = bam_algo_words(n);
+
+    sym = bam_algo_rows(bam, words);
+    succ = bam_algo_transpose(bam, words);
+    visited = calloc(words, sizeof(uint64_t));
+    frontier = calloc(words, sizeof(uint64_t));
+    members = malloc(n * sizeof(uint32_t));
+
+    if( ! sym || ! succ || ! visited || ! frontier || ! members ){
+        puts("bam_connected_components: allocation failed");
+        free(sym);
+        free(succ);
+        free(visited);
+        free(frontier);
+        free(members);
+        return 0;
+    }
+
+    /* fold the column direction in so that direction does not matter */
+    BAM_PARALLEL_FOR
+    for( i=0; i < (size_t) n * words; ++i ){
+        sym[i] |= succ[i];
+    }
+
+    free(succ);
+
+    for( seed=0; seed < n; ++seed ){
+        if( visited[seed / 64] & (((uint64_t) 1) << (seed % 64)) ){
+            continue;
+        }
+
+        /* peel off the component containing seed */
+        visited[seed / 64] |= ((uint64_t) 1) << (seed % 64);
+        frontier[seed / 64] |= ((uint64_t) 1) << (seed % 64);
+
+        do {
+            /* gather the frontier so each word below can be built independently */
+            n_members = 0;
+            for( v = bam_algo_next_bit(frontier, words, 0);
+                 v < n;
+                 v = bam_algo_next_bit(frontier, words, v + 1) ){
+                members[n_members++] = v;
+                labels[v] = n_components;
+            }
+
+            grew = 0;
+
+            /* next frontier is the OR of the frontier's rows less anything visited */
+            BAM_PARALLEL_FOR
+            for( w=0; w < words; ++w ){
+                uint64_t next = 0;
+                unsigned int m = 0;
+
+                for( m=0; m < n_members; ++m ){
+                    next |= sym[(size_t) members[m] * words + w];
+                }
+
+                next &= ~visited[w];
+                frontier[w] = next;
+                visited[w] |= next;
+            }
+
+            for( w=0; w < words; ++w ){
+                if( frontier[w] ){
+                    grew = 1;
+                    break;
+                }
+            }
+        } while( grew );
+
+        ++n_components;
+    }
+
+    free(sym);
+    free(visited);
+    free(frontier);
+    free(members);
+
+    return n_components;
+}
+
+/* copy the selected nodes whose rows are in [begin, end) of `src` one bit
+ * at a time, see bam_induced_subgraph
+ */
+void bam_algo_gather_kernel(struct bitwise_adj_mat *src, unsigned int begin, unsigned int end, void *arg){
+    struct bam_algo_subgraph_work *work = arg;
+    size_t i = 0;
+
+    BAM_PARALLEL_FOR
+    for( i=0; i < work->k; ++i ){
+        const uint8_t *row = &(src->cells[(size_t) work->nodes[i] * src->n_cols]);
+        uint8_t *out = &(work->dst->cells[i * work->dst->n_cols]);
+        size_t j = 0;
+
+        if( work->nodes[i] < begin || work->nodes[i] >= end ){
+            continue;
+        }
+
+        for( j=0; j < work->k; ++j ){
+            out[j / 8] |= ((row[work->nodes[j] / 8] >> (work->nodes[j] % 8)) & 1) << (j % 8);
+        }
+    }
+}
+
+/* copy the selected nodes whose rows are in [begin, end) of `src` a word
+ * at a time, see bam_induced_subgraph
+ */
+void bam_algo_compact_kernel(struct bitwise_adj_mat *src, unsigned int begin, unsigned int end, void *arg){
+    struct bam_algo_subgraph_work *work = arg;
+    size_t i = 0;
+
+    BAM_PARALLEL_FOR
+    for( i=0; i < work->k; ++i ){
+        const uint8_t *row = &(src->cells[(size_t) work->nodes[i] * src->n_cols]);
+        uint8_t *out = &(work->dst->cells[i * work->dst->n_cols]);
+        size_t pos = 0;
+        unsigned int w = 0;
+
+        if( work->nodes[i] < begin || work->nodes[i] >= end ){
+            continue;
+        }
+
+        for( w=0; w < work->words; ++w ){
+            if( ! work->mask[w] ){
+                continue;
+            }
+
+            bam_algo_append_bits(out, pos, bam_algo_pext(bam_algo_load_word(row, src->n_cols, w), work->mask[w]), __builtin_popcountll(work->mask[w]));
+            pos += __builtin_popcountll(work->mask[w]);
+        }
+    }
+}
+
+/* extract the subgraph of `src` induced by the `k` nodes in `nodes` into
+ * the initialised `dst`, any existing contents of `dst` are replaced
+ *
+ * node `nodes[i]` of `src` becomes node `i` of `dst`, so `dst` has an edge
+ * i -> j iff `src` has an edge nodes[i] -> nodes[j]
+ *
+ * when `nodes` is strictly increasing the selected columns of each row are
+ * compacted 64 at a time (with PEXT if built with -mbmi2), otherwise they
+ * are gathered one bit at a time
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_induced_subgraph(struct bitwise_adj_mat *src, const uint32_t *nodes, size_t k, struct bitwise_adj_mat *dst){
+    struct bam_algo_subgraph_work work;
+    uint64_t *mask = 0;
+    unsigned int words = 0;
+    unsigned int sorted = 1;
+    size_t i = 0;
+
+    if( ! src ){
+        puts("bam_induced_subgraph: src was null");
+        return 0;
+    }
+
+    if( ! dst ){
+        puts("bam_induced_subgraph: dst was null");
+        return 0;
+    }
+
+    if( src == dst ){
+        puts("bam_induced_subgraph: src and dst must differ");
+        return 0;
+    }
+
+    /* replacing `dst` wholesale would bypass its log, and could not be
+     * logged anyway as a log has no way to shrink a matrix
+     */
+    if( dst->read_only ){
+        puts("bam_induced_subgraph: dst is read only");
+        return 0;
+    }
+
+    if( dst->log ){
+        puts("bam_induced_subgraph: dst has a log attached");
+        return 0;
+    }
+
+    if( k && ! nodes ){
+        puts("bam_induced_subgraph: nodes was null");
+        return 0;
+    }
+
+    if( k > src->n_rows ){
+        puts("bam_induced_subgraph: k larger than number of nodes");
+        return 0;
+    }
+
+    for( i=0; i < k; ++i ){
+        if( nodes[i] >= src->n_rows ){
+            puts("bam_induced_subgraph: node is out of range");
+            return 0;
+        }
+        if( i && nodes[i] <= nodes[i - 1] ){
+            sorted = 0;
+        }
+    }
+
+    /* start from an empty matrix of the right size */
+    if( ! bam_destroy(dst, 0) || ! bam_init(dst, k) ){
+        puts("bam_induced_subgraph: failed to reinitialise dst");
+        return 0;
+    }
+
+    if( ! k ){
+        return 1;
+    }
+
+    work.dst = dst;
+    work.nodes = nodes;
+    work.k = k;
+    work.mask = 0;
+    work.words = 0;
+
+    if( ! sorted ){
+        /* arbitrary order, gather each selected column in turn */
+        if( ! bam_algo_for_rows(src, bam_algo_gather_kernel, &work) ){
+            puts("bam_induced_subgraph: call to bam_algo_for_rows failed");
+            return 0;
+        }
+
+        return 1;
+    }
+
+    /* increasing order, the selected columns can be compacted a word at a
+     * time by one precomputed column mask
+     */
+    words = bam_algo_words(src->n_rows);
+
+    mask = calloc(words, sizeof(uint64_t));
+    if( ! mask ){
+        puts("bam_induced_subgraph: call to calloc failed");
+        return 0;
+    }
+
+    for( i=0; i < k; ++i ){
+        mask[nodes[i] / 64] |= ((uint64_t) 1) << (nodes[i] % 64);
+    }
+
+    work.mask = mask;
+    work.words = words;
+
+    if( ! bam_algo_for_rows(src, bam_algo_compact_kernel, &work) ){
+        puts("bam_induced_subgraph: call to bam_algo_for_rows failed");
+        free(mask);
+        return 0;
+    }
+
+    free(mask);
+
+    return 1;
+}
+
+/* find every node within `k` hops of `src`, including `src` itself
+ *
+ * `bitset_out` must have room for bam->n_cols bytes and uses the same
+ * layout as a row of `cells`, on success bit `node % 8` of byte `node / 8`
+ * is set iff `node` is reachable from `src` by a path of at most `k` edges
+ *
+ * returns number of nodes within `k` hops on success
+ * returns 0 on error
+ */
+unsigned int bam_khop(struct bitwise_adj_mat *bam, unsigned int src, unsigned int k, uint8_t *bitset_out){
+    struct bam_algo_khop_work work;
+    unsigned int words = 0;
+    uint64_t *reached = 0;
+    uint64_t *frontier = 0;
+    uint64_t *next = 0;
+    unsigned int *active = 0;
+    unsigned int n_reached = 1;
+    unsigned int level = 0;
+    unsigned int v = 0;
+    unsigned int w = 0;
+
+    if( ! bam ){
+        puts("bam_khop: bam was null");
+        return 0;
+    }
+
+    if( ! bitset_out ){
+        puts("bam_khop: bitset_out was null");
+        return 0;
+    }
+
+    if( src >= bam->n_rows ){
+        puts("bam_khop: src is out of range");
+        return 0;
+    }
+
+    words = bam_algo_words(bam->n_rows);
+
+    reached = calloc(words, sizeof(uint64_t));
+    frontier = calloc(words, sizeof(uint64_t));
+    next = calloc(words, sizeof(uint64_t));
+    active = calloc(words, sizeof(unsigned int));
+    if( ! reached || ! frontier || ! next || ! active ){
+        puts("bam_khop: call to calloc failed");
+        free(reached);
+        free(frontier);
+        free(next);
+        free(active);
+        return 0;
+    }
+
+    reached[src / 64] |= ((uint64_t) 1) << (src % 64);
+    frontier[src / 64] |= ((uint64_t) 1) << (src % 64);
+    active[0] = src / 64;
+
+    work.frontier = frontier;
+    work.reached = reached;
+    work.next = next;
+    work.active = active;
+    work.n_active = 1;
+
+    for( level=0; level < k && work.n_active; ++level ){
+        memset(next, 0, words * sizeof(uint64_t));
+
+        if( ! bam_algo_for_rows(bam, bam_algo_khop_kernel, &work) ){
+            puts("bam_khop: call to bam_algo_for_rows failed");
+            free(reached);
+            free(frontier);
+            free(next);
+            free(active);
+            return 0;
+        }
+
+        work.n_active = 0;
+        for( w=0; w < words; ++w ){
+            frontier[w] = next[w];
+            reached[w] |= next[w];
+            n_reached += __builtin_popcountll(next[w]);
+            if( next[w] ){
+                active[work.n_active++] = w;
+            }
+        }
+    }
+
+    /* back out to the byte layout of a row of cells */
+    for( v=0; v < bam->n_cols; ++v ){
+        bitset_out[v] = (reached[v / 8] >> (8 * (v % 8))) & 0xFF;
+    }
+
+    free(reached);
+    free(frontier);
+    free(next);
+    free(active);
+
+    return n_reached;
+}
+
+/* find every node within `k` hops of each of the `n_srcs` nodes in `srcs`
+ * advancing all of them together, `n_srcs` must be at most BAM_KHOP_MAX_SOURCES
+ *
+ * `reach_out` must have room for bam_size(bam) entries, on success bit `i`
+ * of `reach_out[node]` is set iff `node` is within `k` hops of `srcs[i]`
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_khop_multi(struct bitwise_adj_mat *bam, const uint32_t *srcs, unsigned int n_srcs, unsigned int k, uint64_t *reach_out){
+    unsigned int i = 0;
+
+    if( ! bam ){
+        puts("bam_khop_multi: bam was null");
+        return 0;
+    }
+
+    if( ! srcs || ! reach_out ){
+        puts("bam_khop_multi: srcs and reach_out must not be null");
+        return 0;
+    }
+
+    if( n_srcs > BAM_KHOP_MAX_SOURCES ){
+        puts("bam_khop_multi: too many sources");
+        return 0;
+    }
+
+    for( i=0; i < n_srcs; ++i ){
+        if( srcs[i] >= bam->n_rows ){
+            puts("bam_khop_multi: source is out of range");
+            return 0;
+        }
+    }
+
+    if( ! bam_algo_hops(bam, srcs, n_srcs, k, reach_out, 0) ){
+        puts("bam_khop_multi: call to bam_algo_hops failed");
+        return 0;
+    }
+
+    return 1;
+}
+
+/* find the number of hops on a shortest path between every pair of nodes
+ *
+ * `dist` must have room for bam_size(bam) * bam_size(bam) entries,
+ * on success `dist[from * bam_size(bam) + to]` is the distance from -> to,
+ * or BAM_HOPS_UNREACHABLE
+ *
+ * sources are advanced BAM_KHOP_MAX_SOURCES at a time
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_apsp_hops(struct bitwise_adj_mat *bam, uint8_t *dist){
+    uint32_t srcs[BAM_KHOP_MAX_SOURCES];
+    uint64_t *reach = 0;
+    unsigned int n = 0;
+    unsigned int base = 0;
+    unsigned int n_srcs = 0;
+    unsigned int i = 0;
+
+    if( ! bam ){
+        puts("bam_apsp_hops: bam was null");
+        return 0;
+    }
+
+    if( ! dist ){
+        puts("bam_apsp_hops: dist was null");
+        return 0;
+    }
+
+    n = bam->n_rows;
+    if( ! n ){
+        return 1;
+    }
+
+    reach = malloc(n * sizeof(uint64_t));
+    if( ! reach ){
+        puts("bam_apsp_hops: call to malloc failed");
+        return 0;
+    }
+
+    memset(dist, BAM_HOPS_UNREACHABLE, (size_t) n * n);
+
+    for( base=0; base < n; base += BAM_KHOP_MAX_SOURCES ){
+        n_srcs = n - base;
+        if( n_srcs > BAM_KHOP_MAX_SOURCES ){
+            n_srcs = BAM_KHOP_MAX_SOURCES;
+        }
+
+        for( i=0; i < n_srcs; ++i ){
+            srcs[i] = base + i;
+        }
+
+        /* rows of dist for this batch are contiguous */
+        if( ! bam_algo_hops(bam, srcs, n_srcs, BAM_HOPS_UNREACHABLE - 1, reach, &(dist[(size_t) base * n])) ){
+            puts("bam_apsp_hops: call to bam_algo_hops failed");
+            free(reach);
+            return 0;
+        }
+    }
+
+    free(reach);
+
+    return 1;
+}
+
@@ -0,0 +1,136 @@
+#ifndef BITWISE_ADJ_MAT_ALGO_H
+#define BITWISE_ADJ_MAT_ALGO_H
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint32_t */
+
+#include "bitwise_adj_mat.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* graph algorithms over a bitwise_adj_mat
+ *
+ * these work directly on the packed `cells`, 64 edges at a time,
+ * rather than going through bam_test_edge one edge at a time
+ *
+ * the bulk phases (unpacking and transposing rows, k hop frontiers,
+ * hop distances and induced subgraphs) are run in parallel when compiled
+ * with -fopenmp, which the default config.mk does, without it everything
+ * runs on the calling thread
+ *
+ * for a shared memory matrix created with BAM_NUMA_PARTITION those row loops
+ * are split with bam_numa_run, each node's rows handled on that node
+ */
+
+/* maximum number of sources advanced together by bam_khop_multi,
+ * one per bit of a uint64_t
+ */
+#define BAM_KHOP_MAX_SOURCES 64
+
+/* distance reported by bam_apsp_hops for nodes that cannot be reached
+ * within BAM_HOPS_UNREACHABLE - 1 hops
+ */
+#define BAM_HOPS_UNREACHABLE 255
+
+/* find the strongly connected components of `bam`
+ *
+ * `component_out` must have room for bam_size(bam) entries,
+ * on success `component_out[node]` is the component `node` belongs to
+ *
+ * components are numbered in topological order of the condensation,
+ * so for every edge from -> to, component_out[from] <= component_out[to]
+ *
+ * returns number of components on success (which may be 0)
+ * returns 0 on error
+ */
+unsigned int bam_scc(struct bitwise_adj_mat *bam, uint32_t *component_out);
+
+/* find a topological order of the nodes in `bam`
+ *
+ * `order_out` must have room for bam_size(bam) entries,
+ * on success for every edge from -> to, `from` appears before `to`
+ *
+ * returns 1 on success
+ * returns 0 on failure, including if `bam` contains a cycle
+ */
+unsigned int bam_toposort(struct bitwise_adj_mat *bam, uint32_t *order_out);
+
+/* find the weakly connected components of `bam`,
+ * that is the components when the direction of edges is ignored
+ *
+ * `labels` must have room for bam_size(bam) entries,
+ * on success `labels[node]` is the component `node` belongs to
+ *
+ * components are numbered in order of their lowest numbered node
+ *
+ * returns number of components on success (which may be 0)
+ * returns 0 on error
+ */
+unsigned int bam_connected_components(struct bitwise_adj_mat *bam, uint32_t *labels);
+
+/* extract the subgraph of `src` induced by the `k` nodes in `nodes` into
+ * the initialised `dst`, any existing contents of `dst` are replaced
+ *
+ * node `nodes[i]` of `src` becomes node `i` of `dst`, so `dst` has an edge
+ * i -> j iff `src` has an edge nodes[i] -> nodes[j]
+ *
+ * `dst` must not be read only or have a log attached
+ *
+ * when `nodes` is strictly increasing the selected columns of each row are
+ * compacted 64 at a time (with PEXT if built with -mbmi2), otherwise they
+ * are gathered one bit at a time
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_induced_subgraph(struct bitwise_adj_mat *src, const uint32_t *nodes, size_t k, struct bitwise_adj_mat *dst);
+
+/* find every node within `k` hops of `src`, including `src` itself
+ *
+ * `bitset_out` must have room for bam->n_cols bytes and uses the same
+ * layout as a row of `cells`, on success bit `node % 8` of byte `node / 8`
+ * is set iff `node` is reachable from `src` by a path of at most `k` edges
+ *
+ * rows hold predecessors, so each hop pulls every node not yet reached by
+ * testing its row against the frontier, reading only the words of the row
+ * where the frontier is non-zero, a hop from a frontier within 64 node
+ * numbers of each other costs one 8 byte load per unreached node, O(n),
+ * and a frontier spread over every word costs O(n * n / 64)
+ *
+ * returns number of nodes within `k` hops on success
+ * returns 0 on error
+ */
+unsigned int bam_khop(struct bitwise_adj_mat *bam, unsigned int src, unsigned int k, uint8_t *bitset_out);
+
+/* find every node within `k` hops of each of the `n_srcs` nodes in `srcs`
+ * advancing all of them together, `n_srcs` must be at most BAM_KHOP_MAX_SOURCES
+ *
+ * `reach_out` must have room for bam_size(bam) entries, on success bit `i`
+ * of `reach_out[node]` is set iff `node` is within `k` hops of `srcs[i]`
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_khop_multi(struct bitwise_adj_mat *bam, const uint32_t *srcs, unsigned int n_srcs, unsigned int k, uint64_t *reach_out);
+
+/* find the number of hops on a shortest path between every pair of nodes
+ *
+ * `dist` must have room for bam_size(bam) * bam_size(bam) entries,
+ * on success `dist[from * bam_size(bam) + to]` is the distance from -> to,
+ * or BAM_HOPS_UNREACHABLE
+ *
+ * sources are advanced BAM_KHOP_MAX_SOURCES at a time
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_apsp_hops(struct bitwise_adj_mat *bam, uint8_t *dist);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //BITWISE_ADJ_MAT_ALGO_H
+
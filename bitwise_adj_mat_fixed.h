@@ -0,0 +1,221 @@
+#ifndef BITWISE_ADJ_MAT_FIXED_H
+#define BITWISE_ADJ_MAT_FIXED_H
+
+#include <stdio.h> /* puts */
+#include <stdint.h> /* uint64_t, uint16_t */
+#include <string.h> /* memset */
+
+#include "bitwise_adj_mat.h"
+
+/* fixed capacity adjacency matrices for small graphs
+ *
+ * BAM_FIXED_DEFINE(N) defines `struct bam_fixed_N` holding up to N nodes
+ * with every row stored inline, so there is no heap allocation and no
+ * pointer to chase on each probe, along with static inline functions
+ * prefixed `bam_fixed_N_`
+ *
+ * as N is a compile time constant every loop over the words of a row
+ * has a constant trip count and is unrolled by the compiler, for N <= 64
+ * a row is a single uint64_t
+ *
+ * layout matches bitwise_adj_mat, row `to` bit `from` is set iff there is
+ * an edge from -> to, so rows can be copied straight out of `cells`
+ *
+ * variants for 64, 128 and 256 nodes are defined below
+ */
+
+/* number of uint64_t words in a row of a fixed matrix with `N` nodes */
+#define BAM_FIXED_WORDS(N) (((N) + 63) / 64)
+
+/* distance reported by bfs for nodes that cannot be reached */
+#define BAM_FIXED_UNREACHABLE UINT16_MAX
+
+#define BAM_FIXED_DEFINE(N) \
+\
+struct bam_fixed_##N { \
+    /* number of nodes in use, at most N */ \
+    unsigned int n_nodes; \
+\
+    /* rows[to] bit from is set iff there is an edge from -> to */ \
+    uint64_t rows[N][BAM_FIXED_WORDS(N)]; \
+}; \
+\
+/* initialise `g` with `num_nodes` nodes and no edges \
+ * `num_nodes` must be at most N \
+ * \
+ * returns 1 on success \
+ * returns 0 on failure \
+ */ \
+static inline unsigned int bam_fixed_##N##_init(struct bam_fixed_##N *g, unsigned int num_nodes){ \
+    if( num_nodes > (N) ){ \
+        puts("bam_fixed_" #N "_init: num_nodes exceeds capacity"); \
+        return 0; \
+    } \
+    memset(g->rows, 0, sizeof(g->rows)); \
+    g->n_nodes = num_nodes; \
+    return 1; \
+} \
+\
+/* add a directed edge from node number `from` to node number `to` \
+ * \
+ * returns 1 on success \
+ * returns 0 on failure \
+ */ \
+static inline unsigned int bam_fixed_##N##_add_edge(struct bam_fixed_##N *g, unsigned int from, unsigned int to){ \
+    if( from >= g->n_nodes || to >= g->n_nodes ){ \
+        puts("bam_fixed_" #N "_add_edge: node is out of range"); \
+        return 0; \
+    } \
+    g->rows[to][from / 64] |= ((uint64_t) 1) << (from % 64); \
+    return 1; \
+} \
+\
+/* remove the directed edge from node number `from` to node number `to` \
+ * \
+ * returns 1 on success \
+ * returns 0 on failure \
+ */ \
+static inline unsigned int bam_fixed_##N##_remove_edge(struct bam_fixed_##N *g, unsigned int from, unsigned int to){ \
+    if( from >= g->n_nodes || to >= g->n_nodes ){ \
+        puts("bam_fixed_" #N "_remove_edge: node is out of range"); \
+        return 0; \
+    } \
+    g->rows[to][from / 64] &= ~(((uint64_t) 1) << (from % 64)); \
+    return 1; \
+} \
+\
+/* test if an edge exists from node number `from` to node number `to` \
+ * \
+ * returns 1 if edge exists \
+ * returns 0 if edge does not exist or either node is out of range \
+ */ \
+static inline unsigned int bam_fixed_##N##_test_edge(const struct bam_fixed_##N *g, unsigned int from, unsigned int to){ \
+    if( from >= g->n_nodes || to >= g->n_nodes ){ \
+        return 0; \
+    } \
+    return (g->rows[to][from / 64] >> (from % 64)) & 1; \
+} \
+\
+/* copy every edge of `bam` into `g` \
+ * `bam` must have at most N nodes \
+ * \
+ * returns 1 on success \
+ * returns 0 on failure \
+ */ \
+static inline unsigned int bam_fixed_##N##_from_bam(struct bam_fixed_##N *g, const struct bitwise_adj_mat *bam){ \
+    unsigned int row = 0; \
+    unsigned int col = 0; \
+    if( ! bam ){ \
+        puts("bam_fixed_" #N "_from_bam: bam was null"); \
+        return 0; \
+    } \
+    if( ! bam_fixed_##N##_init(g, bam->n_rows) ){ \
+        puts("bam_fixed_" #N "_from_bam: call to init failed"); \
+        return 0; \
+    } \
+    for( row=0; row < bam->n_rows; ++row ){ \
+        for( col=0; col < bam->n_cols; ++col ){ \
+            g->rows[row][col / 8] |= ((uint64_t) bam->cells[row * bam->n_cols + col]) << (8 * (col % 8)); \
+        } \
+    } \
+    return 1; \
+} \
+\
+/* compute the transitive closure of `g` into `out` \
+ * `out` has an edge from -> to iff there is a path of one or more edges \
+ * `out` may be the same as `g` \
+ */ \
+static inline void bam_fixed_##N##_closure(const struct bam_fixed_##N *g, struct bam_fixed_##N *out){ \
+    unsigned int k = 0; \
+    unsigned int i = 0; \
+    unsigned int w = 0; \
+    if( out != g ){ \
+        *out = *g; \
+    } \
+    /* warshall, if k -> i then everything reaching k also reaches i */ \
+    for( k=0; k < out->n_nodes; ++k ){ \
+        for( i=0; i < out->n_nodes; ++i ){ \
+            if( (out->rows[i][k / 64] >> (k % 64)) & 1 ){ \
+                for( w=0; w < BAM_FIXED_WORDS(N); ++w ){ \
+                    out->rows[i][w] |= out->rows[k][w]; \
+                } \
+            } \
+        } \
+    } \
+} \
+\
+/* breadth first search from `src` \
+ * \
+ * `reached` must have room for BAM_FIXED_WORDS(N) words and is set to \
+ * the set of nodes reachable from `src`, including `src` itself \
+ * \
+ * if `dist` is non-0 it must have room for N entries and `dist[node]` \
+ * is set to the number of edges on a shortest path from `src`, \
+ * or BAM_FIXED_UNREACHABLE \
+ * \
+ * returns number of nodes reached on success \
+ * returns 0 if `src` is out of range \
+ */ \
+static inline unsigned int bam_fixed_##N##_bfs(const struct bam_fixed_##N *g, unsigned int src, uint64_t *reached, uint16_t *dist){ \
+    uint64_t frontier[BAM_FIXED_WORDS(N)]; \
+    uint64_t next[BAM_FIXED_WORDS(N)]; \
+    uint64_t any = 0; \
+    uint64_t hit = 0; \
+    unsigned int n_reached = 1; \
+    uint16_t level = 0; \
+    unsigned int v = 0; \
+    unsigned int w = 0; \
+    if( src >= g->n_nodes ){ \
+        puts("bam_fixed_" #N "_bfs: src is out of range"); \
+        return 0; \
+    } \
+    for( w=0; w < BAM_FIXED_WORDS(N); ++w ){ \
+        reached[w] = 0; \
+        frontier[w] = 0; \
+    } \
+    if( dist ){ \
+        for( v=0; v < g->n_nodes; ++v ){ \
+            dist[v] = BAM_FIXED_UNREACHABLE; \
+        } \
+        dist[src] = 0; \
+    } \
+    reached[src / 64] |= ((uint64_t) 1) << (src % 64); \
+    frontier[src / 64] |= ((uint64_t) 1) << (src % 64); \
+    do { \
+        ++level; \
+        any = 0; \
+        for( w=0; w < BAM_FIXED_WORDS(N); ++w ){ \
+            next[w] = 0; \
+        } \
+        /* pull, v is next if any of its predecessors is in the frontier */ \
+        for( v=0; v < g->n_nodes; ++v ){ \
+            if( (reached[v / 64] >> (v % 64)) & 1 ){ \
+                continue; \
+            } \
+            hit = 0; \
+            for( w=0; w < BAM_FIXED_WORDS(N); ++w ){ \
+                hit |= g->rows[v][w] & frontier[w]; \
+            } \
+            if( hit ){ \
+                next[v / 64] |= ((uint64_t) 1) << (v % 64); \
+                ++n_reached; \
+                if( dist ){ \
+                    dist[v] = level; \
+                } \
+            } \
+        } \
+        for( w=0; w < BAM_FIXED_WORDS(N); ++w ){ \
+            frontier[w] = next[w]; \
+            reached[w] |= next[w]; \
+            any |= next[w]; \
+        } \
+    } while( any ); \
+    return n_reached; \
+}
+
+BAM_FIXED_DEFINE(64)
+BAM_FIXED_DEFINE(128)
+BAM_FIXED_DEFINE(256)
+
+#endif //BITWISE_ADJ_MAT_FIXED_H
+
@@ -0,0 +1,855 @@
+/* needed for fsync, ftruncate and friends under -std=c99 */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h> /* puts, rename */
+#include <stdlib.h> /* malloc, realloc, free */
+#include <string.h> /* strlen, strrchr, memcpy */
+#include <errno.h> /* errno, EINTR */
+#include <fcntl.h> /* open */
+#include <unistd.h> /* write, read, fsync, close, lseek, ftruncate */
+#include <sys/stat.h> /* fstat */
+
+#include "bitwise_adj_mat.h"
+#include "bitwise_adj_mat_log.h"
+
+/* leaving this in place as we have some internal only helper functions
+ * that we only exposed to allow for easy testing and extension
+ */
+#pragma GCC diagnostic ignored "-Wmissing-prototypes"
+
+/* internal functions from bitwise_adj_mat.c */
+unsigned int bam_set_edge(struct bitwise_adj_mat *bam, unsigned int col, unsigned int row, unsigned int value);
+
+/* magic at the start of every saved image */
+static const uint8_t bam_image_magic[4] = { 'B', 'A', 'M', 1 };
+
+/* size of image header, magic followed by n_rows */
+#define BAM_IMAGE_HEADER_SIZE 8
+
+/* initial size of the pending buffer */
+#define BAM_LOG_INITIAL_CAP (BAM_LOG_RECORD_SIZE * 256)
+
+/**********************************************
+ **********************************************
+ **********************************************
+ ******** simple helper functions *************
+ **********************************************
+ **********************************************
+ ***********************************************/
+
+/* encode `value` into `buf` as 4 little endian bytes */
+void bam_log_put_u32(uint8_t *buf, unsigned int value){
+    buf[0] = value & 0xFF;
+    buf[1] = (value >> 8) & 0xFF;
+    buf[2] = (value >> 16) & 0xFF;
+    buf[3] = (value >> 24) & 0xFF;
+}
+
+/* decode 4 little endian bytes from `buf` */
+unsigned int bam_log_get_u32(const uint8_t *buf){
+    return ((unsigned int) buf[0])
+         | ((unsigned int) buf[1] << 8)
+         | ((unsigned int) buf[2] << 16)
+         | ((unsigned int) buf[3] << 24);
+}
+
+/* write all `len` bytes of `buf` to `fd`, retrying on short writes
+ *
+ * returns 1 on success
+ * returns 0 on error
+ */
+unsigned int bam_log_write_all(int fd, const uint8_t *buf, size_t len){
+    ssize_t ret = 0;
+
+    while( len ){
+        ret = write(fd, buf, len);
+        if( ret < 0 ){
+            if( errno == EINTR ){
+                continue;
+            }
+            puts("bam_log_write_all: call to write failed");
+            return 0;
+        }
+
+        buf += ret;
+        len -= ret;
+    }
+
+    return 1;
+}
+
+/* read exactly `len` bytes from `fd` into `buf`
+ *
+ * returns 1 on success
+ * returns 0 on error or early end of file
+ */
+unsigned int bam_log_read_all(int fd, uint8_t *buf, size_t len){
+    ssize_t ret = 0;
+
+    while( len ){
+        ret = read(fd, buf, len);
+        if( ret < 0 ){
+            if( errno == EINTR ){
+                continue;
+            }
+            puts("bam_log_read_all: call to read failed");
+            return 0;
+        }
+
+        if( ret == 0 ){
+            puts("bam_log_read_all: unexpected end of file");
+            return 0;
+        }
+
+        buf += ret;
+        len -= ret;
+    }
+
+    return 1;
+}
+
+/* start the empty log open for appending as `fd` with a BAM_LOG_GENERATION
+ * record for `generation` and make it durable
+ *
+ * returns 1 on success
+ * returns 0 on error
+ */
+unsigned int bam_log_write_header(int fd, unsigned long generation){
+    uint8_t record[BAM_LOG_RECORD_SIZE];
+
+    record[0] = BAM_LOG_GENERATION;
+    bam_log_put_u32(&(record[1]), generation);
+    bam_log_put_u32(&(record[5]), 0);
+
+    if( ! bam_log_write_all(fd, record, BAM_LOG_RECORD_SIZE) ){
+        puts("bam_log_write_header: call to bam_log_write_all failed");
+        return 0;
+    }
+
+    if( fsync(fd) ){
+        puts("bam_log_write_header: call to fsync failed");
+        return 0;
+    }
+
+    return 1;
+}
+
+/* read the generation from the first record of the log open as `fd`
+ *
+ * returns generation on success
+ * returns 0 on error
+ */
+unsigned long bam_log_read_header(int fd){
+    uint8_t record[BAM_LOG_RECORD_SIZE];
+
+    if( lseek(fd, 0, SEEK_SET) < 0 || ! bam_log_read_all(fd, record, BAM_LOG_RECORD_SIZE) ){
+        puts("bam_log_read_header: failed to read first record");
+        return 0;
+    }
+
+    if( record[0] != BAM_LOG_GENERATION ){
+        puts("bam_log_read_header: log does not start with a generation record");
+        return 0;
+    }
+
+    return bam_log_get_u32(&(record[1]));
+}
+
+/* fsync the directory holding `path` so that a rename into it is durable
+ *
+ * returns 1 on success
+ * returns 0 on error
+ */
+unsigned int bam_log_sync_dir(const char *path){
+    const char *slash = 0;
+    char *dir = 0;
+    size_t len = 0;
+    int fd = -1;
+
+    slash = strrchr(path, '/');
+    if( ! slash ){
+        len = 1;
+        path = ".";
+    } else if( slash == path ){
+        len = 1;
+    } else {
+        len = slash - path;
+    }
+
+    dir = malloc(len + 1);
+    if( ! dir ){
+        puts("bam_log_sync_dir: call to malloc failed");
+        return 0;
+    }
+    memcpy(dir, path, len);
+    dir[len] = '\0';
+
+    fd = open(dir, O_RDONLY);
+    free(dir);
+    if( fd < 0 ){
+        puts("bam_log_sync_dir: call to open failed");
+        return 0;
+    }
+
+    if( fsync(fd) ){
+        puts("bam_log_sync_dir: call to fsync failed");
+        close(fd);
+        return 0;
+    }
+
+    if( close(fd) ){
+        puts("bam_log_sync_dir: call to close failed");
+        return 0;
+    }
+
+    return 1;
+}
+
+/* apply `len` bytes of whole records from `records` to `bam`
+ * `*applied` is set to the number of bytes of records applied
+ *
+ * returns 1 on success
+ * returns 0 on error
+ */
+unsigned int bam_log_apply_records(struct bitwise_adj_mat *bam, const uint8_t *records, size_t len, size_t *applied){
+    const uint8_t *record = 0;
+    unsigned int a = 0;
+    unsigned int b = 0;
+    size_t i = 0;
+
+    *applied = 0;
+
+    for( i=0; i < len; i += BAM_LOG_RECORD_SIZE ){
+        record = &(records[i]);
+        a = bam_log_get_u32(&(record[1]));
+        b = bam_log_get_u32(&(record[5]));
+
+        if( record[0] == BAM_LOG_RESIZE ){
+            /* matrices never shrink, so an older resize can be skipped */
+            if( a > bam->n_rows && ! bam_resize(bam, a) ){
+                puts("bam_log_apply_records: call to bam_resize failed");
+                return 0;
+            }
+            *applied = i + BAM_LOG_RECORD_SIZE;
+            continue;
+        }
+
+        if( a >= bam->n_rows || b >= bam->n_rows ){
+            puts("bam_log_apply_records: record refers to a node out of range");
+            return 0;
+        }
+
+        if( record[0] != BAM_LOG_ADD && record[0] != BAM_LOG_REMOVE ){
+            puts("bam_log_apply_records: unknown record type");
+            return 0;
+        }
+
+        /* bam_set_edge unshares the cell and does not log, col is from and row is to */
+        if( ! bam_set_edge(bam, a, b, record[0] == BAM_LOG_ADD) ){
+            puts("bam_log_apply_records: call to bam_set_edge failed");
+            return 0;
+        }
+
+        *applied = i + BAM_LOG_RECORD_SIZE;
+    }
+
+    return 1;
+}
+
+
+/**********************************************
+ **********************************************
+ **********************************************
+ ******** bitwise_adj_mat_log.h implementation
+ **********************************************
+ **********************************************
+ ***********************************************/
+
+/* open the log at `path` for appending, creating it at generation 1
+ * if needed
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_log_open(struct bam_log *log, const char *path){
+    struct stat st;
+
+    if( ! log ){
+        puts("bam_log_open: log was null");
+        return 0;
+    }
+
+    if( ! path ){
+        puts("bam_log_open: path was null");
+        return 0;
+    }
+
+    /* read as well as append, to get at the generation */
+    log->fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if( log->fd < 0 ){
+        puts("bam_log_open: call to open failed");
+        return 0;
+    }
+
+    if( fstat(log->fd, &st) ){
+        puts("bam_log_open: call to fstat failed");
+        close(log->fd);
+        log->fd = -1;
+        return 0;
+    }
+
+    if( st.st_size == 0 ){
+        log->generation = 1;
+        if( ! bam_log_write_header(log->fd, log->generation) ){
+            puts("bam_log_open: call to bam_log_write_header failed");
+            close(log->fd);
+            log->fd = -1;
+            return 0;
+        }
+    } else {
+        log->generation = bam_log_read_header(log->fd);
+        if( ! log->generation ){
+            puts("bam_log_open: call to bam_log_read_header failed");
+            close(log->fd);
+            log->fd = -1;
+            return 0;
+        }
+    }
+
+    log->pending = malloc(BAM_LOG_INITIAL_CAP);
+    if( ! log->pending ){
+        puts("bam_log_open: call to malloc failed");
+        close(log->fd);
+        log->fd = -1;
+        return 0;
+    }
+
+    log->n_pending = 0;
+    log->cap_pending = BAM_LOG_INITIAL_CAP;
+
+    return 1;
+}
+
+/* commit any pending records and close the log
+ *
+ * any matrix the log is attached to must be detached first
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_log_close(struct bam_log *log){
+    unsigned int ret = 1;
+
+    if( ! log ){
+        puts("bam_log_close: log was null");
+        return 0;
+    }
+
+    if( ! bam_log_commit(log) ){
+        puts("bam_log_close: call to bam_log_commit failed");
+        ret = 0;
+    }
+
+    if( close(log->fd) ){
+        puts("bam_log_close: call to close failed");
+        ret = 0;
+    }
+
+    free(log->pending);
+    log->pending = 0;
+    log->n_pending = 0;
+    log->cap_pending = 0;
+    log->fd = -1;
+
+    return ret;
+}
+
+/* attach `log` to `bam` so that every successful bam_add_edge, bam_remove_edge
+ * and bam_resize on `bam` is recorded to it
+ *
+ * `log` may be 0 to detach any existing log
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_log_attach(struct bitwise_adj_mat *bam, struct bam_log *log){
+    if( ! bam ){
+        puts("bam_log_attach: bam was null");
+        return 0;
+    }
+
+    if( bam->read_only ){
+        puts("bam_log_attach: bam is read only");
+        return 0;
+    }
+
+    bam->log = log;
+
+    return 1;
+}
+
+/* append a record to the pending records of `log`
+ * this is called for you by mutations on an attached matrix
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_log_append(struct bam_log *log, unsigned int op, unsigned int a, unsigned int b){
+    uint8_t *new_pending = 0;
+    uint8_t *record = 0;
+
+    if( ! log ){
+        puts("bam_log_append: log was null");
+        return 0;
+    }
+
+    if( op != BAM_LOG_ADD && op != BAM_LOG_REMOVE && op != BAM_LOG_RESIZE ){
+        puts("bam_log_append: unknown op");
+        return 0;
+    }
+
+    /* grow pending buffer if needed */
+    if( log->n_pending + BAM_LOG_RECORD_SIZE > log->cap_pending ){
+        new_pending = realloc(log->pending, log->cap_pending * 2);
+        if( ! new_pending ){
+            puts("bam_log_append: call to realloc failed");
+            return 0;
+        }
+        log->pending = new_pending;
+        log->cap_pending *= 2;
+    }
+
+    record = &(log->pending[log->n_pending]);
+    record[0] = op;
+    bam_log_put_u32(&(record[1]), a);
+    bam_log_put_u32(&(record[5]), b);
+
+    log->n_pending += BAM_LOG_RECORD_SIZE;
+
+    return 1;
+}
+
+/* drop the most recently appended pending record
+ * used when a mutation fails after it was appended
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_log_discard(struct bam_log *log){
+    if( ! log ){
+        puts("bam_log_discard: log was null");
+        return 0;
+    }
+
+    if( log->n_pending < BAM_LOG_RECORD_SIZE ){
+        puts("bam_log_discard: no pending record to discard");
+        return 0;
+    }
+
+    log->n_pending -= BAM_LOG_RECORD_SIZE;
+
+    return 1;
+}
+
+/* write all pending records to disk with a single write followed by
+ * a single fsync
+ *
+ * if the write fails part way the log is truncated back to where it
+ * started, so it only ever holds whole records and the pending records
+ * can be committed again later
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_log_commit(struct bam_log *log){
+    off_t end = 0;
+
+    if( ! log ){
+        puts("bam_log_commit: log was null");
+        return 0;
+    }
+
+    /* nothing to do */
+    if( ! log->n_pending ){
+        return 1;
+    }
+
+    end = lseek(log->fd, 0, SEEK_END);
+    if( end < 0 ){
+        puts("bam_log_commit: call to lseek failed");
+        return 0;
+    }
+
+    /* an earlier failed commit that could not be rolled back left part
+     * of a record behind, drop it so that records stay aligned
+     */
+    if( end % BAM_LOG_RECORD_SIZE ){
+        end -= end % BAM_LOG_RECORD_SIZE;
+        if( ftruncate(log->fd, end) ){
+            puts("bam_log_commit: call to ftruncate failed");
+            return 0;
+        }
+    }
+
+    if( ! bam_log_write_all(log->fd, log->pending, log->n_pending) ){
+        puts("bam_log_commit: call to bam_log_write_all failed");
+        if( ftruncate(log->fd, end) ){
+            puts("bam_log_commit: call to ftruncate failed");
+        }
+        return 0;
+    }
+
+    if( fsync(log->fd) ){
+        puts("bam_log_commit: call to fsync failed");
+        return 0;
+    }
+
+    log->n_pending = 0;
+
+    return 1;
+}
+
+/* fold the log into a new base image
+ *
+ * commits any pending records, atomically replaces the image at `base_path`
+ * with the current contents of `bam` and then truncates the log
+ *
+ * `bam` must be the matrix `log` has been recording
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_log_compact(struct bitwise_adj_mat *bam, struct bam_log *log, const char *base_path){
+    if( ! bam ){
+        puts("bam_log_compact: bam was null");
+        return 0;
+    }
+
+    if( ! log ){
+        puts("bam_log_compact: log was null");
+        return 0;
+    }
+
+    /* the log must be durable before the image it is folded into replaces
+     * the old base, otherwise a crash in between loses mutations
+     */
+    if( ! bam_log_commit(log) ){
+        puts("bam_log_compact: call to bam_log_commit failed");
+        return 0;
+    }
+
+    if( ! bam_save(bam, base_path) ){
+        puts("bam_log_compact: call to bam_save failed");
+        return 0;
+    }
+
+    /* a crash before this point leaves records in the log that are
+     * already in the new base, which is fine as replay is idempotent
+     */
+    if( ftruncate(log->fd, 0) ){
+        puts("bam_log_compact: call to ftruncate failed");
+        return 0;
+    }
+
+    /* a standby still on the old generation must reload the base */
+    if( ! bam_log_write_header(log->fd, log->generation + 1) ){
+        puts("bam_log_compact: call to bam_log_write_header failed");
+        return 0;
+    }
+
+    ++log->generation;
+
+    return 1;
+}
+
+/* write a full image of `bam` to `path`
+ *
+ * the image is written to a temporary file which is fsync-ed and then
+ * renamed over `path`, so `path` always holds a complete image, the
+ * directory is then fsync-ed so that the rename survives a crash
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_save(struct bitwise_adj_mat *bam, const char *path){
+    uint8_t header[BAM_IMAGE_HEADER_SIZE];
+    char *tmp_path = 0;
+    size_t path_len = 0;
+    int fd = -1;
+
+    if( ! bam ){
+        puts("bam_save: bam was null");
+        return 0;
+    }
+
+    if( ! path ){
+        puts("bam_save: path was null");
+        return 0;
+    }
+
+    path_len = strlen(path);
+    tmp_path = malloc(path_len + sizeof(".tmp"));
+    if( ! tmp_path ){
+        puts("bam_save: call to malloc failed");
+        return 0;
+    }
+    memcpy(tmp_path, path, path_len);
+    memcpy(&(tmp_path[path_len]), ".tmp", sizeof(".tmp"));
+
+    fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if( fd < 0 ){
+        puts("bam_save: call to open failed");
+        free(tmp_path);
+        return 0;
+    }
+
+    memcpy(header, bam_image_magic, sizeof(bam_image_magic));
+    bam_log_put_u32(&(header[4]), bam->n_rows);
+
+    if( ! bam_log_write_all(fd, header, BAM_IMAGE_HEADER_SIZE) ||
+        ! bam_log_write_all(fd, bam->cells, (size_t) bam->n_cols * bam->n_rows) ){
+        puts("bam_save: call to bam_log_write_all failed");
+        close(fd);
+        free(tmp_path);
+        return 0;
+    }
+
+    if( fsync(fd) ){
+        puts("bam_save: call to fsync failed");
+        close(fd);
+        free(tmp_path);
+        return 0;
+    }
+
+    if( close(fd) ){
+        puts("bam_save: call to close failed");
+        free(tmp_path);
+        return 0;
+    }
+
+    if( rename(tmp_path, path) ){
+        puts("bam_save: call to rename failed");
+        free(tmp_path);
+        return 0;
+    }
+
+    free(tmp_path);
+
+    /* the rename itself is only durable once the directory is,
+     * bam_log_compact relies on this before it truncates the log
+     */
+    if( ! bam_log_sync_dir(path) ){
+        puts("bam_save: call to bam_log_sync_dir failed");
+        return 0;
+    }
+
+    return 1;
+}
+
+/* replace the contents of an initialised `bam` with the image at `path`
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_load(struct bitwise_adj_mat *bam, const char *path){
+    uint8_t header[BAM_IMAGE_HEADER_SIZE];
+    unsigned int num_nodes = 0;
+    struct bam_log *log = 0;
+    int fd = -1;
+
+    if( ! bam ){
+        puts("bam_load: bam was null");
+        return 0;
+    }
+
+    if( ! path ){
+        puts("bam_load: path was null");
+        return 0;
+    }
+
+    if( bam->read_only ){
+        puts("bam_load: bam is read only");
+        return 0;
+    }
+
+    fd = open(path, O_RDONLY);
+    if( fd < 0 ){
+        puts("bam_load: call to open failed");
+        return 0;
+    }
+
+    if( ! bam_log_read_all(fd, header, BAM_IMAGE_HEADER_SIZE) ){
+        puts("bam_load: failed to read header");
+        close(fd);
+        return 0;
+    }
+
+    if( memcmp(header, bam_image_magic, sizeof(bam_image_magic)) ){
+        puts("bam_load: file is not a bitwise_adj_mat image");
+        close(fd);
+        return 0;
+    }
+
+    num_nodes = bam_log_get_u32(&(header[4]));
+
+    /* start again from an empty matrix of the right size
+     * keeping any attached log
+     */
+    log = bam->log;
+
+    if( ! bam_destroy(bam, 0) ){
+        puts("bam_load: call to bam_destroy failed");
+        close(fd);
+        return 0;
+    }
+
+    if( ! bam_init(bam, num_nodes) ){
+        puts("bam_load: call to bam_init failed");
+        close(fd);
+        return 0;
+    }
+
+    bam->log = log;
+
+    if( ! bam_log_read_all(fd, bam->cells, (size_t) bam->n_cols * bam->n_rows) ){
+        puts("bam_load: failed to read cells");
+        close(fd);
+        return 0;
+    }
+
+    close(fd);
+
+    return 1;
+}
+
+/* apply the records in the log at `path` to `bam`
+ *
+ * if `pos` is non-0 then replay starts at `pos->offset` and `pos` is
+ * updated to point just past the last complete record applied, this
+ * allows a standby to repeatedly tail a live log
+ *
+ * if the log has been compacted since `pos` was last updated replay fails
+ * without applying anything, the standby must then bam_load the new base
+ * and continue from a zeroed `pos`, loading the base and the first replay
+ * must not race with a compaction
+ *
+ * a trailing partial record (from a torn write) is ignored
+ *
+ * replay is idempotent, so replaying a log on top of an image that already
+ * contains some of its records is safe
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_replay_log(struct bitwise_adj_mat *bam, const char *path, struct bam_log_pos *pos){
+    struct stat st;
+    struct bam_log *log = 0;
+    uint8_t *records = 0;
+    unsigned long generation = 0;
+    unsigned long start = BAM_LOG_RECORD_SIZE;
+    size_t len = 0;
+    size_t applied = 0;
+    unsigned int ret = 0;
+    int fd = -1;
+
+    if( ! bam ){
+        puts("bam_replay_log: bam was null");
+        return 0;
+    }
+
+    if( ! path ){
+        puts("bam_replay_log: path was null");
+        return 0;
+    }
+
+    if( bam->read_only ){
+        puts("bam_replay_log: bam is read only");
+        return 0;
+    }
+
+    fd = open(path, O_RDONLY);
+    if( fd < 0 ){
+        puts("bam_replay_log: call to open failed");
+        return 0;
+    }
+
+    if( fstat(fd, &st) ){
+        puts("bam_replay_log: call to fstat failed");
+        close(fd);
+        return 0;
+    }
+
+    generation = bam_log_read_header(fd);
+    if( ! generation ){
+        puts("bam_replay_log: call to bam_log_read_header failed");
+        close(fd);
+        return 0;
+    }
+
+    /* offsets into an older generation mean nothing in this one */
+    if( pos && pos->generation && pos->generation != generation ){
+        puts("bam_replay_log: log has been compacted, the base must be reloaded");
+        close(fd);
+        return 0;
+    }
+
+    /* records start after the generation */
+    if( pos && pos->offset > start ){
+        start = pos->offset;
+    }
+
+    if( (unsigned long) st.st_size < start ){
+        puts("bam_replay_log: log is shorter than offset");
+        close(fd);
+        return 0;
+    }
+
+    /* only whole records, ignore any torn tail */
+    len = st.st_size - start;
+    len -= len % BAM_LOG_RECORD_SIZE;
+
+    /* nothing new */
+    if( ! len ){
+        close(fd);
+        if( pos ){
+            pos->generation = generation;
+            pos->offset = start;
+        }
+        return 1;
+    }
+
+    /* read every record in one go */
+    records = malloc(len);
+    if( ! records ){
+        puts("bam_replay_log: call to malloc failed");
+        close(fd);
+        return 0;
+    }
+
+    if( lseek(fd, start, SEEK_SET) < 0 || ! bam_log_read_all(fd, records, len) ){
+        puts("bam_replay_log: failed to read records");
+        free(records);
+        close(fd);
+        return 0;
+    }
+
+    close(fd);
+
+    /* replayed records must not be logged again */
+    log = bam->log;
+    bam->log = 0;
+
+    ret = bam_log_apply_records(bam, records, len, &applied);
+
+    bam->log = log;
+    free(records);
+
+    /* only advance past what was applied */
+    if( pos ){
+        pos->generation = generation;
+        pos->offset = start + applied;
+    }
+
+    return ret;
+}
+
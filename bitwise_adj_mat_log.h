@@ -0,0 +1,187 @@
+#ifndef BITWISE_ADJ_MAT_LOG_H
+#define BITWISE_ADJ_MAT_LOG_H
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint8_t */
+
+#include "bitwise_adj_mat.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* durability for a bitwise_adj_mat between full saves
+ *
+ * a full image of a matrix is written with bam_save and read back with bam_load,
+ * every mutation made after that can be recorded to an append only delta log
+ * which is replayed on top of the image with bam_replay_log
+ *
+ * records are buffered in memory and only hit the disk when bam_log_commit is
+ * called, at which point all pending records are written with a single write
+ * and made durable with a single fsync (group commit)
+ *
+ * each record is 9 bytes
+ *      op  (1 byte)
+ *      a   (4 bytes, little endian)
+ *      b   (4 bytes, little endian)
+ *
+ * for BAM_LOG_ADD and BAM_LOG_REMOVE `a` is from and `b` is to
+ * for BAM_LOG_RESIZE `a` is the new number of nodes and `b` is 0
+ * for BAM_LOG_GENERATION `a` is the generation and `b` is 0
+ *
+ * every log starts with a single BAM_LOG_GENERATION record, a new log
+ * starts at generation 1 and bam_log_compact increments it each time it
+ * empties the log, so a standby tailing the log can tell that the records
+ * it has not yet seen were folded into a new base
+ */
+
+/* size of a single record in bytes */
+#define BAM_LOG_RECORD_SIZE 9
+
+/* record types */
+#define BAM_LOG_ADD    1
+#define BAM_LOG_REMOVE 2
+#define BAM_LOG_RESIZE 3
+#define BAM_LOG_GENERATION 4
+
+struct bam_log {
+    /* file descriptor of log, opened for appending */
+    int fd;
+
+    /* records not yet committed to disk */
+    uint8_t *pending;
+
+    /* number of bytes used in pending */
+    size_t n_pending;
+
+    /* number of bytes allocated for pending */
+    size_t cap_pending;
+
+    /* generation of the log, from its first record */
+    unsigned long generation;
+};
+
+/* how far a standby has replayed a log, see bam_replay_log
+ * a zeroed position replays the whole of whatever log is there
+ */
+struct bam_log_pos {
+    /* generation of the log `offset` refers to, 0 if not yet known */
+    unsigned long generation;
+
+    /* byte just past the last record applied */
+    unsigned long offset;
+};
+
+/* open the log at `path` for appending, creating it at generation 1
+ * if needed
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_log_open(struct bam_log *log, const char *path);
+
+/* commit any pending records and close the log
+ *
+ * any matrix the log is attached to must be detached first
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_log_close(struct bam_log *log);
+
+/* attach `log` to `bam` so that every successful bam_add_edge, bam_remove_edge
+ * and bam_resize on `bam` is recorded to it
+ *
+ * `log` may be 0 to detach any existing log
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_log_attach(struct bitwise_adj_mat *bam, struct bam_log *log);
+
+/* append a record to the pending records of `log`
+ * this is called for you by mutations on an attached matrix
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_log_append(struct bam_log *log, unsigned int op, unsigned int a, unsigned int b);
+
+/* drop the most recently appended pending record
+ * used when a mutation fails after it was appended
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_log_discard(struct bam_log *log);
+
+/* write all pending records to disk with a single write followed by
+ * a single fsync
+ *
+ * if the write fails part way the log is truncated back to where it
+ * started, so it only ever holds whole records and the pending records
+ * can be committed again later
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_log_commit(struct bam_log *log);
+
+/* fold the log into a new base image
+ *
+ * commits any pending records, atomically replaces the image at `base_path`
+ * with the current contents of `bam` and then empties the log, leaving
+ * only a BAM_LOG_GENERATION record one higher than before
+ *
+ * `bam` must be the matrix `log` has been recording
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_log_compact(struct bitwise_adj_mat *bam, struct bam_log *log, const char *base_path);
+
+/* write a full image of `bam` to `path`
+ *
+ * the image is written to a temporary file which is fsync-ed and then
+ * renamed over `path`, so `path` always holds a complete image, the
+ * directory is then fsync-ed so that the rename survives a crash
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_save(struct bitwise_adj_mat *bam, const char *path);
+
+/* replace the contents of an initialised `bam` with the image at `path`
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_load(struct bitwise_adj_mat *bam, const char *path);
+
+/* apply the records in the log at `path` to `bam`
+ *
+ * if `pos` is non-0 then replay starts at `pos->offset` and `pos` is
+ * updated to point just past the last complete record applied, this
+ * allows a standby to repeatedly tail a live log
+ *
+ * if the log has been compacted since `pos` was last updated replay fails
+ * without applying anything, the standby must then bam_load the new base
+ * and continue from a zeroed `pos`, loading the base and the first replay
+ * must not race with a compaction
+ *
+ * a trailing partial record (from a torn write) is ignored
+ *
+ * replay is idempotent, so replaying a log on top of an image that already
+ * contains some of its records is safe
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_replay_log(struct bitwise_adj_mat *bam, const char *path, struct bam_log_pos *pos);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //BITWISE_ADJ_MAT_LOG_H
+
@@ -0,0 +1,517 @@
+/* needed for shm_open, mmap and friends under -std=c99 */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h> /* puts */
+#include <stdlib.h> /* calloc, free */
+#include <string.h> /* memcpy, memcmp */
+#include <errno.h> /* errno, EINTR */
+#include <fcntl.h> /* O_* */
+#include <unistd.h> /* ftruncate, close, read, sysconf */
+#include <pthread.h> /* pthread_create, pthread_join */
+#include <sys/mman.h> /* shm_open, mmap, munmap */
+#include <sys/stat.h> /* fstat */
+
+#ifdef BAM_NUMA
+#include <numa.h> /* numa_* */
+#endif
+
+#include "bitwise_adj_mat.h"
+#include "bitwise_adj_mat_shm.h"
+
+/* leaving this in place as we have some internal only helper functions
+ * that we only exposed to allow for easy testing and extension
+ */
+#pragma GCC diagnostic ignored "-Wmissing-prototypes"
+
+/* magic at the start of every segment */
+static const uint8_t bam_shm_magic[4] = { 'B', 'A', 'M', 'S' };
+
+/* header at the start of every segment, `cells` start `header_size`
+ * bytes in, which is a whole number of pages so that the pages of
+ * `cells` can be placed on NUMA nodes independently of the header
+ */
+struct bam_shm_header {
+    uint8_t magic[4];
+    uint32_t n_rows;
+    uint32_t numa_policy;
+    uint32_t header_size;
+    uint64_t total_size;
+};
+
+/* work handed to each thread of bam_numa_run */
+struct bam_numa_work {
+    struct bitwise_adj_mat *bam;
+    void (*fn)(struct bitwise_adj_mat *bam, unsigned int begin, unsigned int end, void *arg);
+    void *arg;
+    unsigned int node;
+    unsigned int begin;
+    unsigned int end;
+};
+
+/**********************************************
+ **********************************************
+ **********************************************
+ ******** simple helper functions *************
+ **********************************************
+ **********************************************
+ ***********************************************/
+
+/* get the system page size */
+size_t bam_shm_page_size(void){
+    long page = sysconf(_SC_PAGESIZE);
+
+    if( page <= 0 ){
+        return 4096;
+    }
+
+    return page;
+}
+
+/* first row owned by NUMA node `node` of `n_nodes`
+ *
+ * nodes own whole pages of cells, a row belongs to the node owning
+ * the page its first cell is in
+ */
+unsigned int bam_numa_first_row(unsigned int n_rows, unsigned int n_cols, unsigned int node, unsigned int n_nodes){
+    size_t page = bam_shm_page_size();
+    size_t n_pages = 0;
+    size_t first_byte = 0;
+    size_t row = 0;
+
+    if( ! n_cols || node >= n_nodes ){
+        return n_rows;
+    }
+
+    n_pages = ((size_t) n_rows * n_cols + page - 1) / page;
+    first_byte = (n_pages * node / n_nodes) * page;
+
+    /* round up to the first row starting in this page */
+    row = (first_byte + n_cols - 1) / n_cols;
+    if( row > n_rows ){
+        row = n_rows;
+    }
+
+    return row;
+}
+
+/* place the pages of `cells` according to `numa_policy`
+ * must be called before the pages are first touched
+ *
+ * returns 1 on success
+ * returns 0 on error
+ */
+unsigned int bam_shm_place(struct bitwise_adj_mat *bam, unsigned int numa_policy){
+#ifdef BAM_NUMA
+    unsigned int n_nodes = bam_numa_nodes();
+    unsigned int node = 0;
+    size_t begin = 0;
+    size_t end = 0;
+
+    if( n_nodes < 2 ){
+        return 1;
+    }
+
+    if( numa_policy == BAM_NUMA_INTERLEAVE ){
+        numa_interleave_memory(bam->cells, (size_t) bam->n_rows * bam->n_cols, numa_all_nodes_ptr);
+    } else if( numa_policy == BAM_NUMA_PARTITION ){
+        for( node=0; node < n_nodes; ++node ){
+            begin = (size_t) bam_numa_first_row(bam->n_rows, bam->n_cols, node, n_nodes) * bam->n_cols;
+            end = (size_t) bam_numa_first_row(bam->n_rows, bam->n_cols, node + 1, n_nodes) * bam->n_cols;
+
+            /* start of range must be page aligned, the first row of a node
+             * always starts on or just after a page boundary
+             */
+            begin -= begin % bam_shm_page_size();
+            if( end > begin ){
+                numa_tonode_memory(&(bam->cells[begin]), end - begin, node);
+            }
+        }
+    }
+#else
+    (void) bam;
+    (void) numa_policy;
+#endif
+
+    return 1;
+}
+
+/* body of each thread of bam_numa_run */
+void * bam_numa_thread(void *data){
+    struct bam_numa_work *work = data;
+
+#ifdef BAM_NUMA
+    numa_run_on_node(work->node);
+#endif
+
+    work->fn(work->bam, work->begin, work->end, work->arg);
+
+    return 0;
+}
+
+
+/**********************************************
+ **********************************************
+ **********************************************
+ ******** bitwise_adj_mat_shm.h implementation
+ **********************************************
+ **********************************************
+ ***********************************************/
+
+/* create the shared memory segment `name` holding a matrix of `num_nodes`
+ * nodes with no edges, and initialise `bam` to refer to it
+ *
+ * `name` follows shm_open rules, e.g. "/my_graph"
+ * `num_nodes` must be greater than 0
+ * `numa_policy` is one of BAM_NUMA_NONE, BAM_NUMA_INTERLEAVE or BAM_NUMA_PARTITION
+ *
+ * it is an error if the segment already exists
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_shm_create(struct bitwise_adj_mat *bam, const char *name, unsigned int num_nodes, unsigned int numa_policy){
+    struct bam_shm_header header;
+    unsigned int num_cols = 0;
+    size_t total_size = 0;
+    void *mapping = 0;
+    int fd = -1;
+
+    if( ! bam ){
+        puts("bam_shm_create: bam was null");
+        return 0;
+    }
+
+    if( ! name ){
+        puts("bam_shm_create: name was null");
+        return 0;
+    }
+
+    if( ! num_nodes ){
+        puts("bam_shm_create: num_nodes must be greater than 0");
+        return 0;
+    }
+
+    if( numa_policy > BAM_NUMA_PARTITION ){
+        puts("bam_shm_create: unknown numa_policy");
+        return 0;
+    }
+
+    num_cols = (num_nodes + 7) / 8;
+
+    memcpy(header.magic, bam_shm_magic, sizeof(bam_shm_magic));
+    header.n_rows = num_nodes;
+    header.numa_policy = numa_policy;
+    header.header_size = bam_shm_page_size();
+    total_size = header.header_size + (size_t) num_cols * num_nodes;
+    header.total_size = total_size;
+
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if( fd < 0 ){
+        puts("bam_shm_create: call to shm_open failed");
+        return 0;
+    }
+
+    /* new pages read as zero, so there is no need to clear cells */
+    if( ftruncate(fd, total_size) ){
+        puts("bam_shm_create: call to ftruncate failed");
+        close(fd);
+        shm_unlink(name);
+        return 0;
+    }
+
+    mapping = mmap(0, total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if( mapping == MAP_FAILED ){
+        puts("bam_shm_create: call to mmap failed");
+        shm_unlink(name);
+        return 0;
+    }
+
+    bam->n_rows = num_nodes;
+    bam->n_cols = num_cols;
+    bam->cells = (uint8_t *) mapping + header.header_size;
+    bam->cow = 0;
+    bam->read_only = 0;
+    bam->log = 0;
+    bam->mapping = mapping;
+
+    /* the header has a page to itself so writing it touches no cells */
+    memcpy(mapping, &header, sizeof(header));
+
+    /* cells have not been touched yet, so they can still be placed */
+    if( ! bam_shm_place(bam, numa_policy) ){
+        puts("bam_shm_create: call to bam_shm_place failed");
+        bam_shm_detach(bam);
+        shm_unlink(name);
+        return 0;
+    }
+
+    return 1;
+}
+
+/* initialise `bam` to refer to the existing shared memory segment `name`
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_shm_attach(struct bitwise_adj_mat *bam, const char *name){
+    struct bam_shm_header header;
+    struct stat st;
+    void *mapping = 0;
+    ssize_t ret = 0;
+    int fd = -1;
+
+    if( ! bam ){
+        puts("bam_shm_attach: bam was null");
+        return 0;
+    }
+
+    if( ! name ){
+        puts("bam_shm_attach: name was null");
+        return 0;
+    }
+
+    fd = shm_open(name, O_RDWR, 0);
+    if( fd < 0 ){
+        puts("bam_shm_attach: call to shm_open failed");
+        return 0;
+    }
+
+    if( fstat(fd, &st) || (size_t) st.st_size < sizeof(header) ){
+        puts("bam_shm_attach: segment is too small");
+        close(fd);
+        return 0;
+    }
+
+    do {
+        ret = read(fd, &header, sizeof(header));
+    } while( ret < 0 && errno == EINTR );
+
+    if( ret != sizeof(header) ){
+        puts("bam_shm_attach: failed to read header");
+        close(fd);
+        return 0;
+    }
+
+    if( memcmp(header.magic, bam_shm_magic, sizeof(bam_shm_magic)) ||
+        header.total_size != (uint64_t) st.st_size ||
+        header.total_size != header.header_size + (uint64_t) ((header.n_rows + 7) / 8) * header.n_rows ){
+        puts("bam_shm_attach: segment is not a valid bitwise_adj_mat");
+        close(fd);
+        return 0;
+    }
+
+    mapping = mmap(0, header.total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if( mapping == MAP_FAILED ){
+        puts("bam_shm_attach: call to mmap failed");
+        return 0;
+    }
+
+    bam->n_rows = header.n_rows;
+    bam->n_cols = (header.n_rows + 7) / 8;
+    bam->cells = (uint8_t *) mapping + header.header_size;
+    bam->cow = 0;
+    bam->read_only = 0;
+    bam->log = 0;
+    bam->mapping = mapping;
+
+    return 1;
+}
+
+/* unmap the shared memory segment `bam` refers to
+ * the segment and its edges remain until bam_shm_unlink
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_shm_detach(struct bitwise_adj_mat *bam){
+    struct bam_shm_header *header = 0;
+
+    if( ! bam ){
+        puts("bam_shm_detach: bam was null");
+        return 0;
+    }
+
+    if( ! bam->mapping ){
+        puts("bam_shm_detach: bam is not in shared memory");
+        return 0;
+    }
+
+    header = bam->mapping;
+
+    if( munmap(bam->mapping, header->total_size) ){
+        puts("bam_shm_detach: call to munmap failed");
+        return 0;
+    }
+
+    bam->n_rows = 0;
+    bam->n_cols = 0;
+    bam->cells = 0;
+    bam->log = 0;
+    bam->mapping = 0;
+
+    return 1;
+}
+
+/* remove the shared memory segment `name`, it is freed once every
+ * process has detached
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_shm_unlink(const char *name){
+    if( ! name ){
+        puts("bam_shm_unlink: name was null");
+        return 0;
+    }
+
+    if( shm_unlink(name) ){
+        puts("bam_shm_unlink: call to shm_unlink failed");
+        return 0;
+    }
+
+    return 1;
+}
+
+/* get the NUMA policy `bam` was created with
+ *
+ * returns policy on success
+ * returns BAM_NUMA_NONE if `bam` is not in shared memory
+ */
+unsigned int bam_shm_numa_policy(struct bitwise_adj_mat *bam){
+    struct bam_shm_header *header = 0;
+
+    if( ! bam || ! bam->mapping ){
+        return BAM_NUMA_NONE;
+    }
+
+    header = bam->mapping;
+
+    return header->numa_policy;
+}
+
+/* get the number of NUMA nodes rows are spread over
+ *
+ * returns number of nodes, always at least 1
+ */
+unsigned int bam_numa_nodes(void){
+#ifdef BAM_NUMA
+    int n_nodes = 0;
+
+    /* libnuma falls back to a single node when numa is unavailable */
+    if( numa_available() < 0 ){
+        return 1;
+    }
+
+    n_nodes = numa_num_configured_nodes();
+    if( n_nodes < 1 ){
+        return 1;
+    }
+
+    return n_nodes;
+#else
+    return 1;
+#endif
+}
+
+/* get the range of rows [*begin, *end) whose cells live on NUMA node `node`
+ * when `bam` uses BAM_NUMA_PARTITION, the range may be empty
+ *
+ * for any other matrix the same split is returned, it is then just an
+ * even division of the rows
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_numa_rows(struct bitwise_adj_mat *bam, unsigned int node, unsigned int *begin, unsigned int *end){
+    unsigned int n_nodes = bam_numa_nodes();
+
+    if( ! bam ){
+        puts("bam_numa_rows: bam was null");
+        return 0;
+    }
+
+    if( ! begin || ! end ){
+        puts("bam_numa_rows: begin and end must not be null");
+        return 0;
+    }
+
+    if( node >= n_nodes ){
+        puts("bam_numa_rows: node is out of range");
+        return 0;
+    }
+
+    *begin = bam_numa_first_row(bam->n_rows, bam->n_cols, node, n_nodes);
+    *end = bam_numa_first_row(bam->n_rows, bam->n_cols, node + 1, n_nodes);
+
+    return 1;
+}
+
+/* run `fn` once per NUMA node on a thread bound to that node, passing the
+ * range of rows owned by that node as given by bam_numa_rows
+ *
+ * returns once every call has finished
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_numa_run(struct bitwise_adj_mat *bam, void (*fn)(struct bitwise_adj_mat *bam, unsigned int begin, unsigned int end, void *arg), void *arg){
+    struct bam_numa_work *work = 0;
+    pthread_t *threads = 0;
+    unsigned int n_nodes = bam_numa_nodes();
+    unsigned int n_started = 0;
+    unsigned int node = 0;
+    unsigned int ret = 1;
+
+    if( ! bam ){
+        puts("bam_numa_run: bam was null");
+        return 0;
+    }
+
+    if( ! fn ){
+        puts("bam_numa_run: fn was null");
+        return 0;
+    }
+
+    /* single node, no need for any threads */
+    if( n_nodes == 1 ){
+        fn(bam, 0, bam->n_rows, arg);
+        return 1;
+    }
+
+    work = calloc(n_nodes, sizeof(struct bam_numa_work));
+    threads = calloc(n_nodes, sizeof(pthread_t));
+    if( ! work || ! threads ){
+        puts("bam_numa_run: call to calloc failed");
+        free(work);
+        free(threads);
+        return 0;
+    }
+
+    for( node=0; node < n_nodes; ++node ){
+        work[node].bam = bam;
+        work[node].fn = fn;
+        work[node].arg = arg;
+        work[node].node = node;
+        bam_numa_rows(bam, node, &(work[node].begin), &(work[node].end));
+
+        if( pthread_create(&(threads[node]), 0, bam_numa_thread, &(work[node])) ){
+            puts("bam_numa_run: call to pthread_create failed");
+            ret = 0;
+            break;
+        }
+
+        ++n_started;
+    }
+
+    for( node=0; node < n_started; ++node ){
+        pthread_join(threads[node], 0);
+    }
+
+    free(work);
+    free(threads);
+
+    return ret;
+}
+
@@ -0,0 +1,117 @@
+#ifndef BITWISE_ADJ_MAT_SHM_H
+#define BITWISE_ADJ_MAT_SHM_H
+
+#include "bitwise_adj_mat.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* a bitwise_adj_mat whose `cells` live in a named POSIX shared memory
+ * segment, so that several processes on a host can share one matrix
+ *
+ * one process creates the segment with bam_shm_create and any number of
+ * processes may then bam_shm_attach to it, every process sees the edges
+ * added by every other process
+ *
+ * bam_add_edge and bam_remove_edge update the shared cells atomically, so
+ * any number of processes may write at once, a read is only ordered against
+ * writes in other processes by whatever synchronisation the caller uses
+ *
+ * the segment is sized once on creation and cannot be resized
+ *
+ * when built with -DBAM_NUMA (and linked with -lnuma) the pages holding
+ * `cells` are placed across NUMA nodes according to the policy given on
+ * creation, without it there is a single node and the policy is ignored
+ *
+ * for BAM_NUMA_PARTITION the row loops of the algorithms in
+ * bitwise_adj_mat_algo.h go through bam_numa_run, so each node's rows are
+ * worked on by threads running on that node
+ */
+
+/* leave page placement to the kernel (first touch) */
+#define BAM_NUMA_NONE 0
+
+/* spread pages round robin over every NUMA node */
+#define BAM_NUMA_INTERLEAVE 1
+
+/* split rows into one contiguous range per NUMA node, see bam_numa_rows */
+#define BAM_NUMA_PARTITION 2
+
+/* create the shared memory segment `name` holding a matrix of `num_nodes`
+ * nodes with no edges, and initialise `bam` to refer to it
+ *
+ * `name` follows shm_open rules, e.g. "/my_graph"
+ * `num_nodes` must be greater than 0
+ * `numa_policy` is one of BAM_NUMA_NONE, BAM_NUMA_INTERLEAVE or BAM_NUMA_PARTITION
+ *
+ * it is an error if the segment already exists
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_shm_create(struct bitwise_adj_mat *bam, const char *name, unsigned int num_nodes, unsigned int numa_policy);
+
+/* initialise `bam` to refer to the existing shared memory segment `name`
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_shm_attach(struct bitwise_adj_mat *bam, const char *name);
+
+/* unmap the shared memory segment `bam` refers to
+ * the segment and its edges remain until bam_shm_unlink
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_shm_detach(struct bitwise_adj_mat *bam);
+
+/* remove the shared memory segment `name`, it is freed once every
+ * process has detached
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_shm_unlink(const char *name);
+
+/* get the NUMA policy `bam` was created with
+ *
+ * returns policy on success
+ * returns BAM_NUMA_NONE if `bam` is not in shared memory
+ */
+unsigned int bam_shm_numa_policy(struct bitwise_adj_mat *bam);
+
+/* get the number of NUMA nodes rows are spread over
+ *
+ * returns number of nodes, always at least 1
+ */
+unsigned int bam_numa_nodes(void);
+
+/* get the range of rows [*begin, *end) whose cells live on NUMA node `node`
+ * when `bam` uses BAM_NUMA_PARTITION, the range may be empty
+ *
+ * for any other matrix the same split is returned, it is then just an
+ * even division of the rows
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_numa_rows(struct bitwise_adj_mat *bam, unsigned int node, unsigned int *begin, unsigned int *end);
+
+/* run `fn` once per NUMA node on a thread bound to that node, passing the
+ * range of rows owned by that node as given by bam_numa_rows
+ *
+ * returns once every call has finished
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bam_numa_run(struct bitwise_adj_mat *bam, void (*fn)(struct bitwise_adj_mat *bam, unsigned int begin, unsigned int end, void *arg), void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //BITWISE_ADJ_MAT_SHM_H
+
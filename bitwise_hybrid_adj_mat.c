@@ -0,0 +1,638 @@
+#include <stdio.h> /* puts */
+#include <stdlib.h> /* calloc, realloc, free */
+#include <string.h> /* memcpy, memmove, memset */
+
+#include "bitwise_adj_mat.h"
+#include "bitwise_hybrid_adj_mat.h"
+
+/* leaving this in place as we have some internal only helper functions
+ * that we only exposed to allow for easy testing and extension
+ */
+#pragma GCC diagnostic ignored "-Wmissing-prototypes"
+
+/* smallest non-zero capacity of a sparse row */
+#define BHAM_MIN_CAPACITY 4
+
+/**********************************************
+ **********************************************
+ **********************************************
+ ******** simple helper functions *************
+ **********************************************
+ **********************************************
+ ***********************************************/
+
+/* find the position of `from` within the ids of a sparse `row`
+ * `*pos` is set to where `from` is, or where it would be inserted
+ *
+ * returns 1 if `from` is present
+ * returns 0 if `from` is not present
+ */
+unsigned int bham_row_find(struct bham_row *row, unsigned int from, unsigned int *pos){
+    unsigned int low = 0;
+    unsigned int high = row->n_edges;
+    unsigned int mid = 0;
+
+    while( low < high ){
+        mid = low + (high - low) / 2;
+        if( row->ids[mid] < from ){
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    *pos = low;
+
+    return low < row->n_edges && row->ids[low] == from;
+}
+
+/* should a row with `n_edges` be stored as dense cells */
+unsigned int bham_wants_dense(struct bitwise_hybrid_adj_mat *bham, unsigned int n_edges){
+    /* ids would take more space than cells */
+    return (size_t) n_edges * sizeof(uint32_t) > bham->n_cols;
+}
+
+/* should a dense row with `n_edges` go back to being sparse
+ * uses half the promotion threshold so rows do not flip back and forth
+ */
+unsigned int bham_wants_sparse(struct bitwise_hybrid_adj_mat *bham, unsigned int n_edges){
+    return (size_t) n_edges * sizeof(uint32_t) * 2 < bham->n_cols;
+}
+
+/* convert a sparse `row` to dense cells
+ *
+ * returns 1 on success
+ * returns 0 on error
+ */
+unsigned int bham_row_promote(struct bitwise_hybrid_adj_mat *bham, struct bham_row *row){
+    uint8_t *cells = 0;
+    unsigned int i = 0;
+
+    cells = calloc(bham->n_cols, sizeof(uint8_t));
+    if( ! cells ){
+        puts("bham_row_promote: call to calloc failed");
+        return 0;
+    }
+
+    for( i=0; i < row->n_edges; ++i ){
+        cells[row->ids[i] / 8] |= 1 << (row->ids[i] % 8);
+    }
+
+    free(row->ids);
+    row->ids = 0;
+    row->capacity = 0;
+    row->cells = cells;
+    row->kind = BHAM_ROW_DENSE;
+
+    return 1;
+}
+
+/* convert a dense `row` to a sorted array of ids
+ *
+ * returns 1 on success
+ * returns 0 on error
+ */
+unsigned int bham_row_demote(struct bitwise_hybrid_adj_mat *bham, struct bham_row *row){
+    uint32_t *ids = 0;
+    unsigned int capacity = row->n_edges;
+    unsigned int n_ids = 0;
+    unsigned int col = 0;
+    uint8_t cell = 0;
+
+    if( capacity < BHAM_MIN_CAPACITY ){
+        capacity = BHAM_MIN_CAPACITY;
+    }
+
+    ids = malloc(capacity * sizeof(uint32_t));
+    if( ! ids ){
+        puts("bham_row_demote: call to malloc failed");
+        return 0;
+    }
+
+    /* scanning in order keeps ids sorted */
+    for( col=0; col < bham->n_cols; ++col ){
+        cell = row->cells[col];
+        while( cell ){
+            ids[n_ids++] = col * 8 + __builtin_ctz(cell);
+            cell &= cell - 1;
+        }
+    }
+
+    free(row->cells);
+    row->cells = 0;
+    row->ids = ids;
+    row->capacity = capacity;
+    row->kind = BHAM_ROW_SPARSE;
+
+    return 1;
+}
+
+/* set edge representing from -> to to `value`,
+ * promoting or demoting the row as needed
+ *
+ * returns 1 on success
+ * returns 0 on error
+ */
+unsigned int bham_set_edge(struct bitwise_hybrid_adj_mat *bham, unsigned int from, unsigned int to, unsigned int value){
+    struct bham_row *row = 0;
+    uint32_t *ids = 0;
+    unsigned int capacity = 0;
+    unsigned int pos = 0;
+    uint8_t mask = 0;
+
+    if( ! bham ){
+        puts("bham_set_edge: bham was null");
+        return 0;
+    }
+
+    if( from >= bham->n_rows ){
+        puts("bham_set_edge: from node is out of range");
+        return 0;
+    }
+
+    if( to >= bham->n_rows ){
+        puts("bham_set_edge: to node is out of range");
+        return 0;
+    }
+
+    row = &(bham->rows[to]);
+
+    if( row->kind == BHAM_ROW_DENSE ){
+        mask = 1 << (from % 8);
+
+        if( value && ! (row->cells[from / 8] & mask) ){
+            row->cells[from / 8] |= mask;
+            ++row->n_edges;
+        } else if( ! value && (row->cells[from / 8] & mask) ){
+            row->cells[from / 8] &= 0xFF ^ mask;
+            --row->n_edges;
+
+            if( bham_wants_sparse(bham, row->n_edges) && ! bham_row_demote(bham, row) ){
+                puts("bham_set_edge: call to bham_row_demote failed");
+                return 0;
+            }
+        }
+
+        return 1;
+    }
+
+    if( bham_row_find(row, from, &pos) ){
+        if( ! value ){
+            memmove(&(row->ids[pos]), &(row->ids[pos + 1]), (row->n_edges - pos - 1) * sizeof(uint32_t));
+            --row->n_edges;
+        }
+        return 1;
+    }
+
+    /* removing an edge that doesn't exist */
+    if( ! value ){
+        return 1;
+    }
+
+    /* make room */
+    if( row->n_edges == row->capacity ){
+        capacity = row->capacity ? row->capacity * 2 : BHAM_MIN_CAPACITY;
+        ids = realloc(row->ids, capacity * sizeof(uint32_t));
+        if( ! ids ){
+            puts("bham_set_edge: call to realloc failed");
+            return 0;
+        }
+        row->ids = ids;
+        row->capacity = capacity;
+    }
+
+    memmove(&(row->ids[pos + 1]), &(row->ids[pos]), (row->n_edges - pos) * sizeof(uint32_t));
+    row->ids[pos] = from;
+    ++row->n_edges;
+
+    if( bham_wants_dense(bham, row->n_edges) && ! bham_row_promote(bham, row) ){
+        puts("bham_set_edge: call to bham_row_promote failed");
+        return 0;
+    }
+
+    return 1;
+}
+
+
+/**********************************************
+ **********************************************
+ **********************************************
+ ******** bitwise_hybrid_adj_mat.h implementation
+ **********************************************
+ **********************************************
+ ***********************************************/
+
+/* allocate and initialise a new hybrid adj. matrix containing `num_nodes` nodes
+ * `num_nodes` may be 0
+ *
+ * returns * on success
+ * returns 0 on error
+ */
+struct bitwise_hybrid_adj_mat * bham_new(unsigned int num_nodes){
+    struct bitwise_hybrid_adj_mat *mat = 0;
+
+    mat = calloc(1, sizeof(struct bitwise_hybrid_adj_mat));
+    if( ! mat ){
+        puts("bham_new: call to calloc failed");
+        return 0;
+    }
+
+    if( ! bham_init(mat, num_nodes) ){
+        puts("bham_new: call to bham_init failed");
+        free(mat);
+        return 0;
+    }
+
+    return mat;
+}
+
+/* initialise an existing hybrid adj. matrix containing `num_nodes` nodes
+ * `num_nodes` may be 0
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bham_init(struct bitwise_hybrid_adj_mat *bham, unsigned int num_nodes){
+    if( ! bham ){
+        puts("bham_init: bham was null");
+        return 0;
+    }
+
+    /* initialise to 0 */
+    bham->n_cols = 0;
+    bham->n_rows = 0;
+    bham->rows = 0;
+
+    /* only call bham_resize if we have a `num_nodes` > 0 */
+    if( num_nodes ){
+        if( ! bham_resize(bham, num_nodes) ){
+            puts("bham_init: call to bham_resize failed");
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* destroy an existing hybrid adj. matrix
+ * will call free on `bham` if `free_bham` is truethy
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bham_destroy(struct bitwise_hybrid_adj_mat *bham, unsigned int free_bham){
+    unsigned int i = 0;
+
+    if( ! bham ){
+        puts("bham_destroy: bham was null");
+        return 0;
+    }
+
+    if( bham->rows ){
+        for( i=0; i < bham->n_rows; ++i ){
+            free(bham->rows[i].ids);
+            free(bham->rows[i].cells);
+        }
+        free(bham->rows);
+        bham->rows = 0;
+    }
+
+    bham->n_cols = 0;
+    bham->n_rows = 0;
+
+    /* free bham if asked nicely */
+    if( free_bham ){
+        free(bham);
+    }
+
+    return 1;
+}
+
+/* resize an existing hybrid adj. matrix to include enough space for
+ * the number of nodes specified by `num_nodes`
+ * `num_nodes` must be greater than 0 and not less than the current size
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bham_resize(struct bitwise_hybrid_adj_mat *bham, unsigned int num_nodes){
+    struct bham_row *rows = 0;
+    uint8_t *cells = 0;
+    unsigned int num_cols = 0;
+    unsigned int i = 0;
+
+    if( ! bham ){
+        puts("bham_resize: bham was null");
+        return 0;
+    }
+
+    if( ! num_nodes ){
+        puts("bham_resize: num_nodes must be greater than 0");
+        return 0;
+    }
+
+    if( num_nodes < bham->n_rows ){
+        puts("bham_resize: cannot shrink");
+        return 0;
+    }
+
+    num_cols = (num_nodes + 7) / 8;
+
+    /* dense rows must grow to the new width, sparse rows are unaffected */
+    if( num_cols != bham->n_cols ){
+        for( i=0; i < bham->n_rows; ++i ){
+            if( bham->rows[i].kind != BHAM_ROW_DENSE ){
+                continue;
+            }
+
+            cells = realloc(bham->rows[i].cells, num_cols * sizeof(uint8_t));
+            if( ! cells ){
+                puts("bham_resize: call to realloc failed");
+                return 0;
+            }
+
+            memset(&(cells[bham->n_cols]), 0, num_cols - bham->n_cols);
+            bham->rows[i].cells = cells;
+        }
+    }
+
+    rows = realloc(bham->rows, num_nodes * sizeof(struct bham_row));
+    if( ! rows ){
+        puts("bham_resize: call to realloc failed");
+        return 0;
+    }
+
+    /* new rows start out as empty sparse rows */
+    memset(&(rows[bham->n_rows]), 0, (num_nodes - bham->n_rows) * sizeof(struct bham_row));
+
+    bham->rows = rows;
+    bham->n_rows = num_nodes;
+    bham->n_cols = num_cols;
+
+    return 1;
+}
+
+/* get current number of nodes
+ *
+ * returns number of nodes on success (which may be 0)
+ * returns 0 on error
+ */
+unsigned int bham_size(struct bitwise_hybrid_adj_mat *bham){
+    if( ! bham ){
+        puts("bham_size: bham was null");
+        return 0;
+    }
+
+    return bham->n_rows;
+}
+
+/* add a directed edge from node number `from` to node number `to`
+ *
+ * from and to must be less than current size, otherwise it is an error
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bham_add_edge(struct bitwise_hybrid_adj_mat *bham, unsigned int from, unsigned int to){
+    if( ! bham_set_edge(bham, from, to, 1) ){
+        puts("bham_add_edge: call to bham_set_edge failed");
+        return 0;
+    }
+
+    return 1;
+}
+
+/* remove the directed edge from node number `from` to node number `to`.
+ * such an edge doesn't have to already exist
+ *
+ * from and to must be less than current size, otherwise it is an error
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bham_remove_edge(struct bitwise_hybrid_adj_mat *bham, unsigned int from, unsigned int to){
+    if( ! bham_set_edge(bham, from, to, 0) ){
+        puts("bham_remove_edge: call to bham_set_edge failed");
+        return 0;
+    }
+
+    return 1;
+}
+
+/* test if an edge exists from node number `from` to node number `to`.
+ *
+ * if `from` or `to` are not less than current size then `0` is returned
+ *
+ * returns 1 if edge exists
+ * returns 0 if edge does not exist
+ */
+unsigned int bham_test_edge(struct bitwise_hybrid_adj_mat *bham, unsigned int from, unsigned int to){
+    struct bham_row *row = 0;
+    unsigned int pos = 0;
+
+    if( ! bham ){
+        puts("bham_test_edge: bham was null");
+        return 0;
+    }
+
+    if( from >= bham->n_rows ){
+        puts("bham_test_edge: from node is out of range");
+        return 0;
+    }
+
+    if( to >= bham->n_rows ){
+        puts("bham_test_edge: to node is out of range");
+        return 0;
+    }
+
+    row = &(bham->rows[to]);
+
+    if( row->kind == BHAM_ROW_DENSE ){
+        return (row->cells[from / 8] >> (from % 8)) & 1;
+    }
+
+    return bham_row_find(row, from, &pos);
+}
+
+/* find the lowest numbered node at or after `from` with an edge to `to`,
+ * iterate every edge into `to` with
+ *
+ *  for( from = bham_next_edge(bham, 0, to); from < bham_size(bham); from = bham_next_edge(bham, from + 1, to) )
+ *
+ * returns node number if found
+ * returns bham_size(bham) if there is no such node or on error
+ */
+unsigned int bham_next_edge(struct bitwise_hybrid_adj_mat *bham, unsigned int from, unsigned int to){
+    struct bham_row *row = 0;
+    unsigned int pos = 0;
+    unsigned int col = 0;
+    uint8_t cell = 0;
+
+    if( ! bham ){
+        puts("bham_next_edge: bham was null");
+        return 0;
+    }
+
+    if( to >= bham->n_rows ){
+        puts("bham_next_edge: to node is out of range");
+        return bham->n_rows;
+    }
+
+    if( from >= bham->n_rows ){
+        return bham->n_rows;
+    }
+
+    row = &(bham->rows[to]);
+
+    if( row->kind == BHAM_ROW_SPARSE ){
+        bham_row_find(row, from, &pos);
+        return pos < row->n_edges ? row->ids[pos] : bham->n_rows;
+    }
+
+    /* ignore bits before from in the first cell */
+    col = from / 8;
+    cell = row->cells[col] & (0xFF << (from % 8));
+
+    while( ! cell ){
+        ++col;
+        if( col >= bham->n_cols ){
+            return bham->n_rows;
+        }
+        cell = row->cells[col];
+    }
+
+    return col * 8 + __builtin_ctz(cell);
+}
+
+/* OR row `to` into `bitset`, which must have room for n_cols cells
+ * and uses the same layout as a row of bitwise_adj_mat
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bham_row_or(struct bitwise_hybrid_adj_mat *bham, unsigned int to, uint8_t *bitset){
+    struct bham_row *row = 0;
+    unsigned int i = 0;
+
+    if( ! bham ){
+        puts("bham_row_or: bham was null");
+        return 0;
+    }
+
+    if( ! bitset ){
+        puts("bham_row_or: bitset was null");
+        return 0;
+    }
+
+    if( to >= bham->n_rows ){
+        puts("bham_row_or: to node is out of range");
+        return 0;
+    }
+
+    row = &(bham->rows[to]);
+
+    if( row->kind == BHAM_ROW_DENSE ){
+        for( i=0; i < bham->n_cols; ++i ){
+            bitset[i] |= row->cells[i];
+        }
+    } else {
+        for( i=0; i < row->n_edges; ++i ){
+            bitset[row->ids[i] / 8] |= 1 << (row->ids[i] % 8);
+        }
+    }
+
+    return 1;
+}
+
+/* count the edges of row `to` whose `from` is set in `bitset`,
+ * which must have room for n_cols cells
+ *
+ * returns count on success (which may be 0)
+ * returns 0 on error
+ */
+unsigned int bham_row_and_count(struct bitwise_hybrid_adj_mat *bham, unsigned int to, const uint8_t *bitset){
+    struct bham_row *row = 0;
+    unsigned int count = 0;
+    unsigned int i = 0;
+
+    if( ! bham ){
+        puts("bham_row_and_count: bham was null");
+        return 0;
+    }
+
+    if( ! bitset ){
+        puts("bham_row_and_count: bitset was null");
+        return 0;
+    }
+
+    if( to >= bham->n_rows ){
+        puts("bham_row_and_count: to node is out of range");
+        return 0;
+    }
+
+    row = &(bham->rows[to]);
+
+    if( row->kind == BHAM_ROW_DENSE ){
+        for( i=0; i < bham->n_cols; ++i ){
+            count += __builtin_popcount(row->cells[i] & bitset[i]);
+        }
+    } else {
+        for( i=0; i < row->n_edges; ++i ){
+            count += (bitset[row->ids[i] / 8] >> (row->ids[i] % 8)) & 1;
+        }
+    }
+
+    return count;
+}
+
+/* copy every edge of `bham` into the initialised `bam`,
+ * any existing contents of `bam` are replaced
+ *
+ * `bam` must not be read only or have a log attached
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bham_to_bam(struct bitwise_hybrid_adj_mat *bham, struct bitwise_adj_mat *bam){
+    unsigned int i = 0;
+
+    if( ! bham ){
+        puts("bham_to_bam: bham was null");
+        return 0;
+    }
+
+    if( ! bam ){
+        puts("bham_to_bam: bam was null");
+        return 0;
+    }
+
+    /* never overwrite a snapshot, or a logged matrix behind its log's back */
+    if( bam->read_only ){
+        puts("bham_to_bam: bam is read only");
+        return 0;
+    }
+
+    if( bam->log ){
+        puts("bham_to_bam: bam has a log attached");
+        return 0;
+    }
+
+    /* start from an empty matrix of the same size */
+    if( ! bam_destroy(bam, 0) || ! bam_init(bam, bham->n_rows) ){
+        puts("bham_to_bam: failed to reinitialise bam");
+        return 0;
+    }
+
+    /* dense rows have the same layout as a row of cells */
+    for( i=0; i < bham->n_rows; ++i ){
+        if( bham->rows[i].kind == BHAM_ROW_DENSE ){
+            memcpy(&(bam->cells[(size_t) i * bam->n_cols]), bham->rows[i].cells, bham->n_cols);
+        } else if( ! bham_row_or(bham, i, &(bam->cells[(size_t) i * bam->n_cols])) ){
+            puts("bham_to_bam: call to bham_row_or failed");
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
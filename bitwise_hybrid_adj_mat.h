@@ -0,0 +1,174 @@
+#ifndef BITWISE_HYBRID_ADJ_MAT_H
+#define BITWISE_HYBRID_ADJ_MAT_H
+
+#include <stdint.h> /* uint8_t, uint32_t */
+
+#include "bitwise_adj_mat.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* an adjacency matrix for large sparse graphs
+ *
+ * bitwise_adj_mat always spends a bit on every possible edge, this instead
+ * picks a container for each row based on how many edges it holds
+ *
+ *  sparse rows are a sorted array of node ids
+ *  dense rows are n_cols cells laid out exactly like a row of bitwise_adj_mat
+ *
+ * rows are promoted to dense once the array would take more space than
+ * the cells, and demoted back once they fall well below that, so memory
+ * scales with the number of edges while busy rows keep O(1) probes
+ *
+ * as with bitwise_adj_mat, row `to` holds every `from` with an edge from -> to
+ */
+
+/* row stored as a sorted array of from ids */
+#define BHAM_ROW_SPARSE 0
+
+/* row stored as n_cols cells of 8 edges each */
+#define BHAM_ROW_DENSE 1
+
+struct bham_row {
+    /* BHAM_ROW_SPARSE or BHAM_ROW_DENSE */
+    unsigned int kind;
+
+    /* number of edges in this row */
+    unsigned int n_edges;
+
+    /* number of ids allocated in `ids`, only used by sparse rows */
+    unsigned int capacity;
+
+    /* sorted from ids for sparse rows, may be 0 if the row is empty */
+    uint32_t *ids;
+
+    /* n_cols cells for dense rows, 0 for sparse rows */
+    uint8_t *cells;
+};
+
+struct bitwise_hybrid_adj_mat {
+    /* number of rows in matrix
+     * also number of nodes
+     */
+    unsigned int n_rows;
+
+    /* number of cells in a dense row
+     * this is (n_rows +7) / 8
+     */
+    unsigned int n_cols;
+
+    /* one container per row, n_rows of them */
+    struct bham_row *rows;
+};
+
+/* allocate and initialise a new hybrid adj. matrix containing `num_nodes` nodes
+ * `num_nodes` may be 0
+ *
+ * returns * on success
+ * returns 0 on error
+ */
+struct bitwise_hybrid_adj_mat * bham_new(unsigned int num_nodes);
+
+/* initialise an existing hybrid adj. matrix containing `num_nodes` nodes
+ * `num_nodes` may be 0
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bham_init(struct bitwise_hybrid_adj_mat *bham, unsigned int num_nodes);
+
+/* destroy an existing hybrid adj. matrix
+ * will call free on `bham` if `free_bham` is truethy
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bham_destroy(struct bitwise_hybrid_adj_mat *bham, unsigned int free_bham);
+
+/* resize an existing hybrid adj. matrix to include enough space for
+ * the number of nodes specified by `num_nodes`
+ * `num_nodes` must be greater than 0 and not less than the current size
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bham_resize(struct bitwise_hybrid_adj_mat *bham, unsigned int num_nodes);
+
+/* get current number of nodes
+ *
+ * returns number of nodes on success (which may be 0)
+ * returns 0 on error
+ */
+unsigned int bham_size(struct bitwise_hybrid_adj_mat *bham);
+
+/* add a directed edge from node number `from` to node number `to`
+ *
+ * from and to must be less than current size, otherwise it is an error
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bham_add_edge(struct bitwise_hybrid_adj_mat *bham, unsigned int from, unsigned int to);
+
+/* remove the directed edge from node number `from` to node number `to`.
+ * such an edge doesn't have to already exist
+ *
+ * from and to must be less than current size, otherwise it is an error
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bham_remove_edge(struct bitwise_hybrid_adj_mat *bham, unsigned int from, unsigned int to);
+
+/* test if an edge exists from node number `from` to node number `to`.
+ *
+ * if `from` or `to` are not less than current size then `0` is returned
+ *
+ * returns 1 if edge exists
+ * returns 0 if edge does not exist
+ */
+unsigned int bham_test_edge(struct bitwise_hybrid_adj_mat *bham, unsigned int from, unsigned int to);
+
+/* find the lowest numbered node at or after `from` with an edge to `to`,
+ * iterate every edge into `to` with
+ *
+ *  for( from = bham_next_edge(bham, 0, to); from < bham_size(bham); from = bham_next_edge(bham, from + 1, to) )
+ *
+ * returns node number if found
+ * returns bham_size(bham) if there is no such node or on error
+ */
+unsigned int bham_next_edge(struct bitwise_hybrid_adj_mat *bham, unsigned int from, unsigned int to);
+
+/* OR row `to` into `bitset`, which must have room for n_cols cells
+ * and uses the same layout as a row of bitwise_adj_mat
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bham_row_or(struct bitwise_hybrid_adj_mat *bham, unsigned int to, uint8_t *bitset);
+
+/* count the edges of row `to` whose `from` is set in `bitset`,
+ * which must have room for n_cols cells
+ *
+ * returns count on success (which may be 0)
+ * returns 0 on error
+ */
+unsigned int bham_row_and_count(struct bitwise_hybrid_adj_mat *bham, unsigned int to, const uint8_t *bitset);
+
+/* copy every edge of `bham` into the initialised `bam`,
+ * any existing contents of `bam` are replaced
+ *
+ * `bam` must not be read only or have a log attached
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bham_to_bam(struct bitwise_hybrid_adj_mat *bham, struct bitwise_adj_mat *bam);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //BITWISE_HYBRID_ADJ_MAT_H
+
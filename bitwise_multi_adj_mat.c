@@ -0,0 +1,413 @@
+#include <stdio.h> /* puts */
+#include <stdlib.h> /* calloc */
+#include <string.h> /* memcpy */
+
+#include "bitwise_adj_mat.h"
+#include "bitwise_multi_adj_mat.h"
+
+/* leaving this in place as we have some internal only helper functions
+ * that we only exposed to allow for easy testing and extension
+ */
+#pragma GCC diagnostic ignored "-Wmissing-prototypes"
+
+/**********************************************
+ **********************************************
+ **********************************************
+ ******** simple helper functions *************
+ **********************************************
+ **********************************************
+ ***********************************************/
+
+/* return pointer to the group of `n_planes` cells holding the 8 edges
+ * around from -> to, cell for plane `p` is at offset `p`
+ *
+ * returns 0 on error
+ */
+uint8_t * bmam_access_cells(struct bitwise_multi_adj_mat *bmam, unsigned int from, unsigned int to){
+    if( ! bmam ){
+        puts("bmam_access_cells: bmam was null");
+        return 0;
+    }
+
+    if( from >= bmam->n_rows ){
+        puts("bmam_access_cells: from node is out of range");
+        return 0;
+    }
+
+    if( to >= bmam->n_rows ){
+        puts("bmam_access_cells: to node is out of range");
+        return 0;
+    }
+
+    /* same layout as bitwise_adj_mat, col is from and row is to */
+    return &(bmam->cells[((size_t) to * bmam->n_cols + (from / 8)) * bmam->n_planes]);
+}
+
+/* set edge of type `plane` representing from -> to to `value`
+ * `value` must be 0 or 1
+ *
+ * returns 1 on success
+ * returns 0 on error
+ */
+unsigned int bmam_set_edge(struct bitwise_multi_adj_mat *bmam, unsigned int plane, unsigned int from, unsigned int to, unsigned int value){
+    uint8_t *cells = 0;
+
+    if( ! bmam ){
+        puts("bmam_set_edge: bmam was null");
+        return 0;
+    }
+
+    if( plane >= bmam->n_planes ){
+        puts("bmam_set_edge: plane is out of range");
+        return 0;
+    }
+
+    cells = bmam_access_cells(bmam, from, to);
+    if( ! cells ){
+        puts("bmam_set_edge: call to bmam_access_cells failed");
+        return 0;
+    }
+
+    if( value ){
+        cells[plane] |= 1 << (from % 8);
+    } else {
+        cells[plane] &= 0xFF ^ (1 << (from % 8));
+    }
+
+    return 1;
+}
+
+
+/**********************************************
+ **********************************************
+ **********************************************
+ ******** bitwise_multi_adj_mat.h implementation
+ **********************************************
+ **********************************************
+ ***********************************************/
+
+/* allocate and initialise a new multi adj. matrix containing `num_nodes` nodes
+ * and `num_planes` edge types
+ * `num_nodes` may be 0
+ *
+ * returns * on success
+ * returns 0 on error
+ */
+struct bitwise_multi_adj_mat * bmam_new(unsigned int num_nodes, unsigned int num_planes){
+    struct bitwise_multi_adj_mat *mat = 0;
+
+    mat = calloc(1, sizeof(struct bitwise_multi_adj_mat));
+    if( ! mat ){
+        puts("bmam_new: call to calloc failed");
+        return 0;
+    }
+
+    if( ! bmam_init(mat, num_nodes, num_planes) ){
+        puts("bmam_new: call to bmam_init failed");
+        free(mat);
+        return 0;
+    }
+
+    return mat;
+}
+
+/* initialise an existing multi adj. matrix containing `num_nodes` nodes
+ * and `num_planes` edge types
+ * `num_nodes` may be 0
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bmam_init(struct bitwise_multi_adj_mat *bmam, unsigned int num_nodes, unsigned int num_planes){
+    if( ! bmam ){
+        puts("bmam_init: bmam was null");
+        return 0;
+    }
+
+    if( ! num_planes || num_planes > BMAM_MAX_PLANES ){
+        puts("bmam_init: num_planes must be between 1 and BMAM_MAX_PLANES");
+        return 0;
+    }
+
+    /* initialise to 0 */
+    bmam->n_cols = 0;
+    bmam->n_rows = 0;
+    bmam->n_planes = num_planes;
+    bmam->cells = 0;
+
+    /* only call bmam_resize if we have a `num_nodes` > 0 */
+    if( num_nodes ){
+        if( ! bmam_resize(bmam, num_nodes) ){
+            puts("bmam_init: call to bmam_resize failed");
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* destroy an existing multi adj. matrix
+ * will call free on `bmam` if `free_bmam` is truethy
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bmam_destroy(struct bitwise_multi_adj_mat *bmam, unsigned int free_bmam){
+    if( ! bmam ){
+        puts("bmam_destroy: bmam was null");
+        return 0;
+    }
+
+    if( bmam->cells ){
+        free(bmam->cells);
+        bmam->cells = 0;
+    }
+
+    bmam->n_cols = 0;
+    bmam->n_rows = 0;
+
+    /* free bmam if asked nicely */
+    if( free_bmam ){
+        free(bmam);
+    }
+
+    return 1;
+}
+
+/* resize every plane of an existing multi adj. matrix to include enough
+ * space for the number of nodes specified by `num_nodes`
+ * `num_nodes` must be greater than 0 and not less than the current size
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bmam_resize(struct bitwise_multi_adj_mat *bmam, unsigned int num_nodes){
+    uint8_t *new_cells = 0;
+    unsigned int num_cols = 0;
+    size_t old_row_size = 0;
+    size_t new_row_size = 0;
+    unsigned int row = 0;
+
+    if( ! bmam ){
+        puts("bmam_resize: bmam was null");
+        return 0;
+    }
+
+    if( ! num_nodes ){
+        puts("bmam_resize: num_nodes must be greater than 0");
+        return 0;
+    }
+
+    if( num_nodes < bmam->n_rows ){
+        puts("bmam_resize: cannot shrink");
+        return 0;
+    }
+
+    num_cols = (num_nodes + 7) / 8;
+
+    old_row_size = (size_t) bmam->n_cols * bmam->n_planes;
+    new_row_size = (size_t) num_cols * bmam->n_planes;
+
+    /* one allocation for every plane */
+    new_cells = calloc(new_row_size * num_nodes, sizeof(uint8_t));
+    if( ! new_cells ){
+        puts("bmam_resize: call to calloc failed");
+        return 0;
+    }
+
+    /* every plane of a row is contiguous, so each row is a single copy */
+    if( bmam->cells ){
+        for( row=0; row < bmam->n_rows; ++row ){
+            memcpy(&(new_cells[row * new_row_size]), &(bmam->cells[row * old_row_size]), old_row_size);
+        }
+
+        free(bmam->cells);
+    }
+
+    /* swap */
+    bmam->cells = new_cells;
+    bmam->n_rows = num_nodes;
+    bmam->n_cols = num_cols;
+
+    return 1;
+}
+
+/* get current number of nodes
+ *
+ * returns number of nodes on success (which may be 0)
+ * returns 0 on error
+ */
+unsigned int bmam_size(struct bitwise_multi_adj_mat *bmam){
+    if( ! bmam ){
+        puts("bmam_size: bmam was null");
+        return 0;
+    }
+
+    return bmam->n_rows;
+}
+
+/* add a directed edge of type `plane` from node number `from` to node number `to`
+ *
+ * from and to must be less than current size, otherwise it is an error
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bmam_add_edge(struct bitwise_multi_adj_mat *bmam, unsigned int plane, unsigned int from, unsigned int to){
+    if( ! bmam_set_edge(bmam, plane, from, to, 1) ){
+        puts("bmam_add_edge: call to bmam_set_edge failed");
+        return 0;
+    }
+
+    return 1;
+}
+
+/* remove the directed edge of type `plane` from node number `from` to node number `to`.
+ * such an edge doesn't have to already exist
+ *
+ * from and to must be less than current size, otherwise it is an error
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bmam_remove_edge(struct bitwise_multi_adj_mat *bmam, unsigned int plane, unsigned int from, unsigned int to){
+    if( ! bmam_set_edge(bmam, plane, from, to, 0) ){
+        puts("bmam_remove_edge: call to bmam_set_edge failed");
+        return 0;
+    }
+
+    return 1;
+}
+
+/* test if an edge of type `plane` exists from node number `from` to node number `to`.
+ *
+ * if `from` or `to` are not less than current size then `0` is returned
+ *
+ * returns 1 if edge exists
+ * returns 0 if edge does not exist
+ */
+unsigned int bmam_test_edge(struct bitwise_multi_adj_mat *bmam, unsigned int plane, unsigned int from, unsigned int to){
+    if( ! bmam ){
+        puts("bmam_test_edge: bmam was null");
+        return 0;
+    }
+
+    if( plane >= bmam->n_planes ){
+        puts("bmam_test_edge: plane is out of range");
+        return 0;
+    }
+
+    return bmam_test_any(bmam, ((uint32_t) 1) << plane, from, to);
+}
+
+/* test if an edge of any type in `mask` exists from node number `from`
+ * to node number `to`, bit `plane` of `mask` selects that plane
+ *
+ * if `from` or `to` are not less than current size then `0` is returned
+ *
+ * returns 1 if edge exists
+ * returns 0 if edge does not exist
+ */
+unsigned int bmam_test_any(struct bitwise_multi_adj_mat *bmam, uint32_t mask, unsigned int from, unsigned int to){
+    return (bmam_edge_types(bmam, from, to) & mask) != 0;
+}
+
+/* get the types of every edge from node number `from` to node number `to`
+ *
+ * if `from` or `to` are not less than current size then `0` is returned
+ *
+ * returns mask with bit `plane` set for each type of edge that exists
+ * returns 0 if no edge exists
+ */
+uint32_t bmam_edge_types(struct bitwise_multi_adj_mat *bmam, unsigned int from, unsigned int to){
+    uint8_t *cells = 0;
+    uint8_t bit = 0;
+    uint32_t types = 0;
+    unsigned int plane = 0;
+
+    cells = bmam_access_cells(bmam, from, to);
+    if( ! cells ){
+        puts("bmam_edge_types: call to bmam_access_cells failed");
+        return 0;
+    }
+
+    bit = 1 << (from % 8);
+
+    /* every plane for this pair is in the same group of adjacent cells */
+    for( plane=0; plane < bmam->n_planes; ++plane ){
+        if( cells[plane] & bit ){
+            types |= ((uint32_t) 1) << plane;
+        }
+    }
+
+    return types;
+}
+
+/* flatten the planes selected by `mask` into the initialised `bam`,
+ * `bam` then has an edge from -> to iff an edge of any type in `mask` exists
+ *
+ * any existing contents of `bam` are replaced, it must not be read only
+ * or have a log attached
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bmam_flatten(struct bitwise_multi_adj_mat *bmam, uint32_t mask, struct bitwise_adj_mat *bam){
+    uint32_t planes[BMAM_MAX_PLANES];
+    unsigned int n_selected = 0;
+    unsigned int plane = 0;
+    size_t n_cells = 0;
+    size_t i = 0;
+    unsigned int p = 0;
+    uint8_t acc = 0;
+    const uint8_t *group = 0;
+
+    if( ! bmam ){
+        puts("bmam_flatten: bmam was null");
+        return 0;
+    }
+
+    if( ! bam ){
+        puts("bmam_flatten: bam was null");
+        return 0;
+    }
+
+    /* the flattened planes replace `bam` outright, which a snapshot
+     * must not see and a log could not record
+     */
+    if( bam->read_only ){
+        puts("bmam_flatten: bam is read only");
+        return 0;
+    }
+
+    if( bam->log ){
+        puts("bmam_flatten: bam has a log attached");
+        return 0;
+    }
+
+    /* start from an empty matrix of the same size */
+    if( ! bam_destroy(bam, 0) || ! bam_init(bam, bmam->n_rows) ){
+        puts("bmam_flatten: failed to reinitialise bam");
+        return 0;
+    }
+
+    for( plane=0; plane < bmam->n_planes; ++plane ){
+        if( mask & (((uint32_t) 1) << plane) ){
+            planes[n_selected++] = plane;
+        }
+    }
+
+    /* bam cells have exactly the same layout as a single plane */
+    n_cells = (size_t) bmam->n_rows * bmam->n_cols;
+    for( i=0; i < n_cells; ++i ){
+        group = &(bmam->cells[i * bmam->n_planes]);
+        acc = 0;
+        for( p=0; p < n_selected; ++p ){
+            acc |= group[planes[p]];
+        }
+        bam->cells[i] = acc;
+    }
+
+    return 1;
+}
+
@@ -0,0 +1,156 @@
+#ifndef BITWISE_MULTI_ADJ_MAT_H
+#define BITWISE_MULTI_ADJ_MAT_H
+
+#include <stdint.h> /* uint8_t, uint32_t */
+
+#include "bitwise_adj_mat.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* maximum number of planes, each plane is one bit of a uint32_t mask */
+#define BMAM_MAX_PLANES 32
+
+/* a set of bitwise adjacency matrices over the same nodes,
+ * one matrix (plane) per edge type
+ *
+ * all planes share their dimensions and are resized together
+ *
+ * planes are interleaved so that the cells of every plane for the same
+ * 8 edges are adjacent in memory, a query touching several edge types
+ * for a node pair therefore touches a single cache line
+ */
+struct bitwise_multi_adj_mat {
+    /* number of rows in each plane
+     * also number of nodes
+     */
+    unsigned int n_rows;
+
+    /* number of columns in each plane
+     * this is (n_rows +7) / 8
+     */
+    unsigned int n_cols;
+
+    /* number of planes (edge types)
+     * must be between 1 and BMAM_MAX_PLANES
+     */
+    unsigned int n_planes;
+
+    /* 3d array of uint8_t with each cell representing 8 edges of one type
+     * stored in row-major order with planes innermost
+     *
+     * index = (row * n_cols + (col / 8)) * n_planes + plane;
+     * edge = cells[index] & 1 << (col % 8);
+     *
+     * current size is n_rows * n_cols * n_planes
+     */
+    uint8_t *cells;
+};
+
+/* allocate and initialise a new multi adj. matrix containing `num_nodes` nodes
+ * and `num_planes` edge types
+ * `num_nodes` may be 0
+ *
+ * returns * on success
+ * returns 0 on error
+ */
+struct bitwise_multi_adj_mat * bmam_new(unsigned int num_nodes, unsigned int num_planes);
+
+/* initialise an existing multi adj. matrix containing `num_nodes` nodes
+ * and `num_planes` edge types
+ * `num_nodes` may be 0
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bmam_init(struct bitwise_multi_adj_mat *bmam, unsigned int num_nodes, unsigned int num_planes);
+
+/* destroy an existing multi adj. matrix
+ * will call free on `bmam` if `free_bmam` is truethy
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bmam_destroy(struct bitwise_multi_adj_mat *bmam, unsigned int free_bmam);
+
+/* resize every plane of an existing multi adj. matrix to include enough
+ * space for the number of nodes specified by `num_nodes`
+ * `num_nodes` must be greater than 0 and not less than the current size
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bmam_resize(struct bitwise_multi_adj_mat *bmam, unsigned int num_nodes);
+
+/* get current number of nodes
+ *
+ * returns number of nodes on success (which may be 0)
+ * returns 0 on error
+ */
+unsigned int bmam_size(struct bitwise_multi_adj_mat *bmam);
+
+/* add a directed edge of type `plane` from node number `from` to node number `to`
+ *
+ * from and to must be less than current size, otherwise it is an error
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bmam_add_edge(struct bitwise_multi_adj_mat *bmam, unsigned int plane, unsigned int from, unsigned int to);
+
+/* remove the directed edge of type `plane` from node number `from` to node number `to`.
+ * such an edge doesn't have to already exist
+ *
+ * from and to must be less than current size, otherwise it is an error
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bmam_remove_edge(struct bitwise_multi_adj_mat *bmam, unsigned int plane, unsigned int from, unsigned int to);
+
+/* test if an edge of type `plane` exists from node number `from` to node number `to`.
+ *
+ * if `from` or `to` are not less than current size then `0` is returned
+ *
+ * returns 1 if edge exists
+ * returns 0 if edge does not exist
+ */
+unsigned int bmam_test_edge(struct bitwise_multi_adj_mat *bmam, unsigned int plane, unsigned int from, unsigned int to);
+
+/* test if an edge of any type in `mask` exists from node number `from`
+ * to node number `to`, bit `plane` of `mask` selects that plane
+ *
+ * if `from` or `to` are not less than current size then `0` is returned
+ *
+ * returns 1 if edge exists
+ * returns 0 if edge does not exist
+ */
+unsigned int bmam_test_any(struct bitwise_multi_adj_mat *bmam, uint32_t mask, unsigned int from, unsigned int to);
+
+/* get the types of every edge from node number `from` to node number `to`
+ *
+ * if `from` or `to` are not less than current size then `0` is returned
+ *
+ * returns mask with bit `plane` set for each type of edge that exists
+ * returns 0 if no edge exists
+ */
+uint32_t bmam_edge_types(struct bitwise_multi_adj_mat *bmam, unsigned int from, unsigned int to);
+
+/* flatten the planes selected by `mask` into the initialised `bam`,
+ * `bam` then has an edge from -> to iff an edge of any type in `mask` exists
+ *
+ * any existing contents of `bam` are replaced, it must not be read only
+ * or have a log attached
+ *
+ * returns 1 on success
+ * returns 0 on failure
+ */
+unsigned int bmam_flatten(struct bitwise_multi_adj_mat *bmam, uint32_t mask, struct bitwise_adj_mat *bam);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //BITWISE_MULTI_ADJ_MAT_H
+
@@ -4,19 +4,36 @@ PREFIX = /usr
 MANPREFIX = ${PREFIX}/share/man
 
 INCS =
-LIBS =
+
+# runs the bulk phases of bitwise_adj_mat_algo.c in parallel,
+# leave empty for a single threaded build on compilers without OpenMP
+OPENMP = -fopenmp
+
+# shm_open and pthreads for bitwise_adj_mat_shm.c
+LIBS = -lrt -lpthread
+
+# to place shared memory matrices across NUMA nodes
+# add -DBAM_NUMA to CFLAGS and -lnuma to LIBS
 
 # NB: including  -fprofile-arcs -ftest-coverage for gcov
 # travis wasn't happy with -Wmaybe-uninitialized  so removed for now
-CFLAGS = -std=c99 -pedantic -Werror -Wall -Wextra -Wstrict-prototypes -Wmissing-prototypes -Wmissing-declarations -Wshadow -Wdeclaration-after-statement -Wunused-function -fprofile-arcs -ftest-coverage ${INCS}
+CFLAGS = -std=c99 -pedantic -Werror -Wall -Wextra -Wstrict-prototypes -Wmissing-prototypes -Wmissing-declarations -Wshadow -Wdeclaration-after-statement -Wunused-function -fprofile-arcs -ftest-coverage ${OPENMP} ${INCS}
 
 # gcov free version
-#CFLAGS = -std=c99 -pedantic -Werror -Wall -Wextra -Wstrict-prototypes -Wmissing-prototypes -Wmissing-declarations -Wshadow -Wdeclaration-after-statement -Wunused-function -Wmaybe-uninitialized ${INCS}
+#CFLAGS = -std=c99 -pedantic -Werror -Wall -Wextra -Wstrict-prototypes -Wmissing-prototypes -Wmissing-declarations -Wshadow -Wdeclaration-after-statement -Wunused-function -Wmaybe-uninitialized ${OPENMP} ${INCS}
+
+# for bitwise_adj_mat.hpp and its tests
+CXXFLAGS = -std=c++17 -pedantic -Werror -Wall -Wextra -Wmissing-declarations -Wshadow -Wunused-function -fprofile-arcs -ftest-coverage ${INCS}
+
+# gcov free version
+#CXXFLAGS = -std=c++17 -pedantic -Werror -Wall -Wextra -Wmissing-declarations -Wshadow -Wunused-function ${INCS}
+
 
 # NB: including  -fprofile-arcs for gcov
-LDFLAGS = -fprofile-arcs ${LIBS}
+LDFLAGS = -fprofile-arcs ${OPENMP} ${LIBS}
 
 # gcov free version
-#LDFLAGS = ${LIBS}
+#LDFLAGS = ${OPENMP} ${LIBS}
 
 CC = cc
+CXX = c++
@@ -1,10 +1,22 @@
 /*  gcc bitwise_adj_mat.c test_bitwise_adj_mat.c -Wall -Wextra -Werror -o test_bam
  * ./test_bam
  */
+#define _POSIX_C_SOURCE 200809L
+
 #include <assert.h> /* assert */
 #include <stdio.h> /* puts */
+#include <stdlib.h> /* malloc, free */
+#include <string.h> /* memset */
+#include <sys/wait.h> /* waitpid */
+#include <unistd.h> /* fork, _exit */
 
 #include "bitwise_adj_mat.h"
+#include "bitwise_adj_mat_log.h"
+#include "bitwise_adj_mat_algo.h"
+#include "bitwise_multi_adj_mat.h"
+#include "bitwise_adj_mat_fixed.h"
+#include "bitwise_adj_mat_shm.h"
+#include "bitwise_hybrid_adj_mat.h"
 
 void simple(void );
 void init(void );
@@ -13,11 +25,29 @@ void sizing(void );
 void null(void);
 void invalid(void);
 void internal(void);
+void snapshot(void);
+void logging(void);
+void scc(void);
+void toposort(void);
+void connected_components(void);
+void multi(void);
+void fixed(void);
+void induced_subgraph(void);
+void hops(void);
+void shm(void);
+void hybrid(void);
+void count_row_edges(struct bitwise_adj_mat *bam, unsigned int begin, unsigned int end, void *arg);
+
+/* helpers */
+struct bitwise_adj_mat * random_graph(unsigned int n_nodes, unsigned int n_edges, unsigned int seed);
 
 /* internal functions to test */
 unsigned char * bam_access_cell(uint8_t *cells, unsigned int n_cols, unsigned int n_rows, unsigned int col, unsigned int row);
 unsigned int bam_set_edge(struct bitwise_adj_mat *bam, unsigned int col, unsigned int row, unsigned int value);
 unsigned int bam_get_edge(struct bitwise_adj_mat *bam, unsigned int col, unsigned int row);
+size_t bam_cow_pick_chunk_size(size_t n_bytes);
+size_t bam_cow_slot(struct bitwise_adj_mat *bam, size_t chunk);
+unsigned int bam_numa_first_row(unsigned int n_rows, unsigned int n_cols, unsigned int node, unsigned int n_nodes);
 
 void simple(void){
     struct bitwise_adj_mat *bam = 0;
@@ -294,6 +324,1144 @@ void internal(void){
     puts("success!");
 }
 
+void snapshot(void){
+    struct bitwise_adj_mat *bam = 0;
+    struct bitwise_adj_mat *snap = 0;
+    struct bitwise_adj_mat *snap2 = 0;
+    unsigned int n = 3000;
+    size_t chunk_size = 0;
+    size_t n_chunks = 0;
+    size_t slot = 0;
+    size_t i = 0;
+    pid_t child = 0;
+    int status = 0;
+
+    puts("\ntesting snapshots (warnings will be printed)");
+
+    bam = bam_new(10);
+    assert( bam );
+
+    assert( bam_add_edge(bam, 0, 1) );
+    assert( bam_add_edge(bam, 9, 3) );
+
+    /* small matrices are only moved into chunks by their first snapshot */
+    assert( bam_cow_slot(bam, 0) == (size_t) -1 );
+
+    snap = bam_snapshot(bam);
+    assert( snap );
+
+    /* taking a snapshot copies nothing, both map the same slot */
+    assert( bam_cow_slot(bam, 0) != (size_t) -1 );
+    assert( bam_cow_slot(snap, 0) == bam_cow_slot(bam, 0) );
+    assert( bam_cow_slot(snap, 1) == (size_t) -1 );
+    assert( bam_size(snap) == 10 );
+
+    /* snapshots refuse mutation */
+    assert( 0 == bam_add_edge(snap, 1, 2) );
+    assert( 0 == bam_remove_edge(snap, 0, 1) );
+    assert( 0 == bam_resize(snap, 20) );
+
+    /* first write copies the chunk */
+    slot = bam_cow_slot(bam, 0);
+    assert( bam_add_edge(bam, 4, 5) );
+    assert( bam_remove_edge(bam, 0, 1) );
+    assert( bam_cow_slot(bam, 0) != slot );
+    assert( bam_cow_slot(snap, 0) == slot );
+
+    assert( bam_test_edge(bam, 4, 5) );
+    assert( 0 == bam_test_edge(bam, 0, 1) );
+    assert( bam_test_edge(bam, 9, 3) );
+
+    assert( 0 == bam_test_edge(snap, 4, 5) );
+    assert( bam_test_edge(snap, 0, 1) );
+    assert( bam_test_edge(snap, 9, 3) );
+
+    /* snapshot of a snapshot */
+    snap2 = bam_snapshot(snap);
+    assert( snap2 );
+    assert( bam_cow_slot(snap2, 0) == slot );
+    assert( bam_destroy(snap, 1) );
+    assert( bam_test_edge(snap2, 0, 1) );
+    assert( bam_destroy(snap2, 1) );
+
+    /* once all snapshots are released the live matrix writes in place */
+    snap = bam_snapshot(bam);
+    assert( snap );
+    assert( bam_destroy(snap, 1) );
+    slot = bam_cow_slot(bam, 0);
+    assert( bam_add_edge(bam, 7, 7) );
+    assert( bam_cow_slot(bam, 0) == slot );
+
+    /* a snapshot outlives the matrix it was taken from */
+    snap = bam_snapshot(bam);
+    assert( snap );
+    assert( bam_resize(bam, 30) );
+    assert( bam_test_edge(bam, 7, 7) );
+    assert( bam_destroy(bam, 1) );
+    assert( bam_size(snap) == 10 );
+    assert( bam_test_edge(snap, 7, 7) );
+    assert( bam_test_edge(snap, 4, 5) );
+    assert( bam_destroy(snap, 1) );
+
+    /* large matrices are also private memory until their first snapshot,
+     * so a forked child writes to its own copy
+     */
+    bam = bam_new(n);
+    assert( bam );
+    chunk_size = bam_cow_pick_chunk_size((size_t) n * bam->n_cols);
+    n_chunks = ((size_t) n * bam->n_cols + chunk_size - 1) / chunk_size;
+    assert( n_chunks > 1 );
+    assert( bam_cow_slot(bam, n_chunks - 1) == (size_t) -1 );
+
+    child = fork();
+    assert( child >= 0 );
+    if( child == 0 ){
+        _exit( bam_add_edge(bam, 3, 4) ? 0 : 1 );
+    }
+    assert( waitpid(child, &status, 0) == child );
+    assert( WIFEXITED(status) && WEXITSTATUS(status) == 0 );
+    assert( 0 == bam_test_edge(bam, 3, 4) );
+
+    assert( bam_add_edge(bam, 1, 2) );
+    assert( bam_add_edge(bam, n - 1, n - 1) );
+
+    snap = bam_snapshot(bam);
+    assert( snap );
+    assert( bam_cow_slot(bam, n_chunks - 1) != (size_t) -1 );
+    for( i=0; i < n_chunks; ++i ){
+        assert( bam_cow_slot(snap, i) == bam_cow_slot(bam, i) );
+    }
+
+    /* a write only copies the chunk it lands in, the last row is in the last chunk */
+    assert( bam_add_edge(bam, 5, n - 1) );
+    for( i=0; i + 1 < n_chunks; ++i ){
+        assert( bam_cow_slot(snap, i) == bam_cow_slot(bam, i) );
+    }
+    assert( bam_cow_slot(snap, n_chunks - 1) != bam_cow_slot(bam, n_chunks - 1) );
+
+    assert( bam_test_edge(bam, 5, n - 1) );
+    assert( 0 == bam_test_edge(snap, 5, n - 1) );
+    assert( bam_test_edge(bam, n - 1, n - 1) );
+    assert( bam_test_edge(snap, n - 1, n - 1) );
+    assert( bam_test_edge(bam, 1, 2) );
+    assert( bam_test_edge(snap, 1, 2) );
+
+    /* and the copy is written in place from then on */
+    slot = bam_cow_slot(bam, n_chunks - 1);
+    assert( bam_add_edge(bam, 6, n - 1) );
+    assert( bam_cow_slot(bam, n_chunks - 1) == slot );
+
+    assert( bam_destroy(snap, 1) );
+    assert( bam_destroy(bam, 1) );
+
+    /* snapshot of an empty matrix */
+    bam = bam_new(0);
+    assert( bam );
+    snap = bam_snapshot(bam);
+    assert( snap );
+    assert( bam_size(snap) == 0 );
+    assert( bam_destroy(snap, 1) );
+    assert( bam_destroy(bam, 1) );
+
+    assert( 0 == bam_snapshot(0) );
+
+    puts("success!");
+}
+
+void logging(void){
+    struct bitwise_adj_mat *bam = 0;
+    struct bitwise_adj_mat *replica = 0;
+    struct bam_log log;
+    struct bam_log_pos pos = {0, 0};
+    unsigned int i = 0;
+    FILE *file = 0;
+    const char *image_path = "test_bam.image";
+    const char *log_path = "test_bam.log";
+
+    puts("\ntesting delta log (warnings will be printed)");
+
+    /* start from a clean slate */
+    remove(image_path);
+    remove(log_path);
+
+    bam = bam_new(4);
+    assert( bam );
+    assert( bam_add_edge(bam, 3, 3) );
+
+    /* base image */
+    assert( bam_save(bam, image_path) );
+
+    assert( bam_log_open(&log, log_path) );
+    assert( log.generation == 1 );
+    assert( bam_log_attach(bam, &log) );
+
+    assert( bam_add_edge(bam, 0, 1) );
+    assert( bam_add_edge(bam, 2, 3) );
+    assert( bam_remove_edge(bam, 0, 1) );
+    assert( bam_resize(bam, 10) );
+    assert( bam_add_edge(bam, 9, 0) );
+
+    /* failed mutations are not logged */
+    assert( 0 == bam_add_edge(bam, 10, 0) );
+    assert( 0 == bam_resize(bam, 0) );
+
+    /* nothing hits the disk until commit */
+    assert( log.n_pending == 5 * BAM_LOG_RECORD_SIZE );
+    assert( bam_log_commit(&log) );
+    assert( log.n_pending == 0 );
+
+    /* standby loads the base and tails the log */
+    replica = bam_new(0);
+    assert( replica );
+    assert( bam_load(replica, image_path) );
+    assert( bam_size(replica) == 4 );
+    assert( bam_test_edge(replica, 3, 3) );
+
+    /* records follow the generation record */
+    assert( bam_replay_log(replica, log_path, &pos) );
+    assert( pos.generation == 1 );
+    assert( pos.offset == 6 * BAM_LOG_RECORD_SIZE );
+    assert( bam_size(replica) == 10 );
+    assert( bam_test_edge(replica, 3, 3) );
+    assert( bam_test_edge(replica, 2, 3) );
+    assert( bam_test_edge(replica, 9, 0) );
+    assert( 0 == bam_test_edge(replica, 0, 1) );
+
+    /* incremental */
+    assert( bam_add_edge(bam, 5, 5) );
+    assert( bam_log_commit(&log) );
+    assert( bam_replay_log(replica, log_path, &pos) );
+    assert( pos.offset == 7 * BAM_LOG_RECORD_SIZE );
+    assert( bam_test_edge(replica, 5, 5) );
+
+    /* replay is idempotent */
+    assert( bam_replay_log(replica, log_path, 0) );
+    assert( bam_size(replica) == 10 );
+    assert( bam_test_edge(replica, 5, 5) );
+    assert( 0 == bam_test_edge(replica, 0, 1) );
+
+    /* fold log into a new base */
+    assert( bam_add_edge(bam, 6, 7) );
+    assert( bam_log_compact(bam, &log, image_path) );
+
+    assert( log.generation == 2 );
+
+    /* standby notices compaction, even once the log has grown past
+     * where it had got to
+     */
+    for( i=0; i < 8; ++i ){
+        assert( bam_add_edge(bam, i, 8) );
+    }
+    assert( bam_log_commit(&log) );
+    assert( 0 == bam_replay_log(replica, log_path, &pos) );
+    assert( pos.generation == 1 );
+    assert( pos.offset == 7 * BAM_LOG_RECORD_SIZE );
+    assert( 0 == bam_test_edge(replica, 0, 8) );
+
+    assert( bam_load(replica, image_path) );
+    pos.generation = 0;
+    pos.offset = 0;
+    assert( bam_replay_log(replica, log_path, &pos) );
+    assert( pos.generation == 2 );
+    assert( pos.offset == 9 * BAM_LOG_RECORD_SIZE );
+    assert( bam_size(replica) == 10 );
+    assert( bam_test_edge(replica, 6, 7) );
+    assert( bam_test_edge(replica, 2, 3) );
+    for( i=0; i < 8; ++i ){
+        assert( bam_test_edge(replica, i, 8) );
+    }
+
+    /* torn trailing record is ignored */
+    assert( bam_add_edge(bam, 1, 2) );
+    assert( bam_log_commit(&log) );
+    file = fopen(log_path, "ab");
+    assert( file );
+    assert( 4 == fwrite("\1\0\0\0", 1, 4, file) );
+    assert( 0 == fclose(file) );
+    assert( bam_replay_log(replica, log_path, &pos) );
+    assert( pos.offset == 10 * BAM_LOG_RECORD_SIZE );
+    assert( bam_test_edge(replica, 1, 2) );
+
+    /* and dropped by the next commit rather than appended after */
+    assert( bam_add_edge(bam, 3, 4) );
+    assert( bam_log_commit(&log) );
+    assert( bam_replay_log(replica, log_path, &pos) );
+    assert( pos.offset == 11 * BAM_LOG_RECORD_SIZE );
+    assert( bam_test_edge(replica, 3, 4) );
+    assert( bam_size(replica) == 10 );
+
+    /* saving into a directory syncs that directory */
+    assert( bam_save(bam, "./test_bam.image2") );
+    assert( bam_load(replica, "./test_bam.image2") );
+    assert( bam_test_edge(replica, 3, 4) );
+    remove("./test_bam.image2");
+
+    assert( bam_log_attach(bam, 0) );
+    assert( bam_log_close(&log) );
+
+    /* reopening keeps the generation */
+    assert( bam_log_open(&log, log_path) );
+    assert( log.generation == 2 );
+    assert( bam_log_close(&log) );
+
+    /* anything else is not a log */
+    assert( 0 == bam_log_open(&log, image_path) );
+
+    assert( 0 == bam_log_open(0, log_path) );
+    assert( 0 == bam_log_attach(0, 0) );
+    assert( 0 == bam_log_commit(0) );
+    assert( 0 == bam_save(0, image_path) );
+    assert( 0 == bam_load(replica, "test_bam.missing") );
+    assert( 0 == bam_replay_log(replica, "test_bam.missing", 0) );
+
+    assert( bam_destroy(replica, 1) );
+    assert( bam_destroy(bam, 1) );
+
+    remove(image_path);
+    remove(log_path);
+
+    puts("success!");
+}
+
+/* deterministic pseudo random graph of `n_nodes` with up to `n_edges` edges */
+struct bitwise_adj_mat * random_graph(unsigned int n_nodes, unsigned int n_edges, unsigned int seed){
+    struct bitwise_adj_mat *bam = 0;
+    unsigned int i = 0;
+    unsigned int from = 0;
+
+    bam = bam_new(n_nodes);
+    assert( bam );
+
+    for( i=0; i<n_edges; ++i ){
+        seed = seed * 1103515245 + 12345;
+        from = (seed >> 8) % n_nodes;
+        seed = seed * 1103515245 + 12345;
+        assert( bam_add_edge(bam, from, (seed >> 8) % n_nodes) );
+    }
+
+    return bam;
+}
+
+void scc(void){
+    struct bitwise_adj_mat *bam = 0;
+    uint32_t components[150];
+    unsigned char *reach = 0;
+    unsigned int n = 150;
+    unsigned int i = 0;
+    unsigned int j = 0;
+    unsigned int k = 0;
+
+    puts("\ntesting strongly connected components");
+
+    /* 0 -> 1 -> 2 -> 0 -> 3 -> 4 -> 3, 5 alone, 6 -> 6 */
+    bam = bam_new(7);
+    assert( bam );
+    assert( bam_add_edge(bam, 0, 1) );
+    assert( bam_add_edge(bam, 1, 2) );
+    assert( bam_add_edge(bam, 2, 0) );
+    assert( bam_add_edge(bam, 0, 3) );
+    assert( bam_add_edge(bam, 3, 4) );
+    assert( bam_add_edge(bam, 4, 3) );
+    assert( bam_add_edge(bam, 6, 6) );
+
+    assert( 4 == bam_scc(bam, components) );
+    assert( components[0] == components[1] );
+    assert( components[0] == components[2] );
+    assert( components[3] == components[4] );
+    assert( components[0] < components[3] );
+    assert( components[5] != components[0] );
+    assert( components[5] != components[3] );
+    assert( components[5] != components[6] );
+    assert( components[6] != components[0] );
+    assert( components[6] != components[3] );
+
+    assert( bam_destroy(bam, 1) );
+
+    /* compare against closure computed edge by edge */
+    bam = random_graph(n, 220, 7);
+
+    reach = malloc(n * n);
+    assert( reach );
+    for( i=0; i<n; ++i ){
+        for( j=0; j<n; ++j ){
+            reach[i * n + j] = (i == j) || bam_test_edge(bam, i, j);
+        }
+    }
+    for( k=0; k<n; ++k ){
+        for( i=0; i<n; ++i ){
+            for( j=0; j<n; ++j ){
+                if( reach[i * n + k] && reach[k * n + j] ){
+                    reach[i * n + j] = 1;
+                }
+            }
+        }
+    }
+
+    assert( bam_scc(bam, components) );
+    for( i=0; i<n; ++i ){
+        for( j=0; j<n; ++j ){
+            assert( (components[i] == components[j]) == (reach[i * n + j] && reach[j * n + i]) );
+            if( bam_test_edge(bam, i, j) ){
+                assert( components[i] <= components[j] );
+            }
+        }
+    }
+
+    free(reach);
+    assert( bam_destroy(bam, 1) );
+
+    bam = bam_new(0);
+    assert( bam );
+    assert( 0 == bam_scc(bam, components) );
+    assert( 0 == bam_scc(0, components) );
+    assert( 0 == bam_scc(bam, 0) );
+    assert( bam_destroy(bam, 1) );
+
+    puts("success!");
+}
+
+void toposort(void){
+    struct bitwise_adj_mat *bam = 0;
+    uint32_t order[100];
+    uint32_t position[100];
+    unsigned int n = 100;
+    unsigned int i = 0;
+    unsigned int j = 0;
+    unsigned int seed = 3;
+
+    puts("\ntesting topological sort (warnings will be printed)");
+
+    /* random dag, every edge goes from a lower to a higher node */
+    bam = bam_new(n);
+    assert( bam );
+    for( i=0; i<300; ++i ){
+        seed = seed * 1103515245 + 12345;
+        j = (seed >> 8) % n;
+        seed = seed * 1103515245 + 12345;
+        if( j != (seed >> 8) % n ){
+            if( j < (seed >> 8) % n ){
+                assert( bam_add_edge(bam, j, (seed >> 8) % n) );
+            } else {
+                assert( bam_add_edge(bam, (seed >> 8) % n, j) );
+            }
+        }
+    }
+
+    assert( bam_toposort(bam, order) );
+
+    for( i=0; i<n; ++i ){
+        position[i] = n;
+    }
+    for( i=0; i<n; ++i ){
+        /* every node appears exactly once */
+        assert( position[order[i]] == n );
+        position[order[i]] = i;
+    }
+    for( i=0; i<n; ++i ){
+        for( j=0; j<n; ++j ){
+            if( bam_test_edge(bam, i, j) ){
+                assert( position[i] < position[j] );
+            }
+        }
+    }
+
+    /* a cycle has no order */
+    assert( bam_add_edge(bam, 99, 0) );
+    assert( bam_add_edge(bam, 0, 99) );
+    assert( 0 == bam_toposort(bam, order) );
+
+    /* nor does a self loop */
+    assert( bam_remove_edge(bam, 99, 0) );
+    assert( bam_toposort(bam, order) );
+    assert( bam_add_edge(bam, 42, 42) );
+    assert( 0 == bam_toposort(bam, order) );
+
+    assert( 0 == bam_toposort(0, order) );
+    assert( 0 == bam_toposort(bam, 0) );
+
+    assert( bam_destroy(bam, 1) );
+
+    puts("success!");
+}
+
+void connected_components(void){
+    struct bitwise_adj_mat *bam = 0;
+    uint32_t labels[200];
+    uint32_t parent[200];
+    unsigned int n = 200;
+    unsigned int n_components = 0;
+    unsigned int i = 0;
+    unsigned int j = 0;
+    unsigned int a = 0;
+    unsigned int b = 0;
+
+    puts("\ntesting connected components");
+
+    /* direction must not matter, 0 -> 1 <- 2, 3 <- 4 */
+    bam = bam_new(6);
+    assert( bam );
+    assert( bam_add_edge(bam, 0, 1) );
+    assert( bam_add_edge(bam, 2, 1) );
+    assert( bam_add_edge(bam, 4, 3) );
+
+    assert( 3 == bam_connected_components(bam, labels) );
+    assert( labels[0] == 0 );
+    assert( labels[1] == 0 );
+    assert( labels[2] == 0 );
+    assert( labels[3] == 1 );
+    assert( labels[4] == 1 );
+    assert( labels[5] == 2 );
+
+    assert( bam_destroy(bam, 1) );
+
+    /* compare against union find over edges probed one by one */
+    bam = random_graph(n, 150, 11);
+
+    for( i=0; i<n; ++i ){
+        parent[i] = i;
+    }
+    for( i=0; i<n; ++i ){
+        for( j=0; j<n; ++j ){
+            if( bam_test_edge(bam, i, j) ){
+                for( a=i; parent[a] != a; a = parent[a] );
+                for( b=j; parent[b] != b; b = parent[b] );
+                parent[a > b ? a : b] = a > b ? b : a;
+            }
+        }
+    }
+
+    n_components = bam_connected_components(bam, labels);
+    assert( n_components );
+
+    for( i=0; i<n; ++i ){
+        for( a=i; parent[a] != a; a = parent[a] );
+        for( j=0; j<n; ++j ){
+            for( b=j; parent[b] != b; b = parent[b] );
+            assert( (labels[i] == labels[j]) == (a == b) );
+        }
+    }
+
+    /* labels are assigned in order of lowest numbered node */
+    j = 0;
+    for( i=0; i<n; ++i ){
+        assert( labels[i] <= j );
+        if( labels[i] == j ){
+            ++j;
+        }
+    }
+    assert( j == n_components );
+
+    assert( bam_destroy(bam, 1) );
+
+    assert( 0 == bam_connected_components(0, labels) );
+
+    puts("success!");
+}
+
+void multi(void){
+    struct bitwise_multi_adj_mat *bmam = 0;
+    struct bitwise_adj_mat bam;
+    struct bitwise_adj_mat *snap = 0;
+    struct bam_log log;
+    unsigned int depends_on = 0;
+    unsigned int owns = 1;
+    unsigned int calls = 2;
+
+    puts("\ntesting multi relation matrices (warnings will be printed)");
+
+    bmam = bmam_new(5, 3);
+    assert( bmam );
+    assert( bmam_size(bmam) == 5 );
+    assert( bmam->n_planes == 3 );
+
+    assert( bmam_add_edge(bmam, depends_on, 0, 1) );
+    assert( bmam_add_edge(bmam, owns, 0, 1) );
+    assert( bmam_add_edge(bmam, calls, 4, 2) );
+    assert( bmam_add_edge(bmam, owns, 3, 3) );
+
+    assert( bmam_test_edge(bmam, depends_on, 0, 1) );
+    assert( bmam_test_edge(bmam, owns, 0, 1) );
+    assert( 0 == bmam_test_edge(bmam, calls, 0, 1) );
+    assert( 0 == bmam_test_edge(bmam, depends_on, 1, 0) );
+    assert( bmam_test_edge(bmam, calls, 4, 2) );
+
+    assert( bmam_edge_types(bmam, 0, 1) == ((1u << depends_on) | (1u << owns)) );
+    assert( bmam_edge_types(bmam, 4, 2) == (1u << calls) );
+    assert( bmam_edge_types(bmam, 2, 4) == 0 );
+
+    assert( bmam_test_any(bmam, (1u << calls) | (1u << owns), 0, 1) );
+    assert( 0 == bmam_test_any(bmam, 1u << calls, 0, 1) );
+
+    /* every plane resizes together */
+    assert( bmam_resize(bmam, 20) );
+    assert( bmam_size(bmam) == 20 );
+    assert( bmam->n_cols == 3 );
+    assert( bmam_test_edge(bmam, depends_on, 0, 1) );
+    assert( bmam_test_edge(bmam, owns, 0, 1) );
+    assert( bmam_test_edge(bmam, calls, 4, 2) );
+    assert( bmam_test_edge(bmam, owns, 3, 3) );
+    assert( bmam_add_edge(bmam, calls, 19, 9) );
+
+    assert( bmam_remove_edge(bmam, owns, 0, 1) );
+    assert( 0 == bmam_test_edge(bmam, owns, 0, 1) );
+    assert( bmam_test_edge(bmam, depends_on, 0, 1) );
+
+    /* flatten selected planes into a plain matrix */
+    assert( bam_init(&bam, 0) );
+    assert( bmam_flatten(bmam, (1u << owns) | (1u << calls), &bam) );
+    assert( bam_size(&bam) == 20 );
+    assert( 0 == bam_test_edge(&bam, 0, 1) );
+    assert( bam_test_edge(&bam, 4, 2) );
+    assert( bam_test_edge(&bam, 3, 3) );
+    assert( bam_test_edge(&bam, 19, 9) );
+    assert( bmam_flatten(bmam, 1u << depends_on, &bam) );
+    assert( bam_test_edge(&bam, 0, 1) );
+    assert( 0 == bam_test_edge(&bam, 4, 2) );
+
+    /* never into a snapshot or a logged matrix */
+    snap = bam_snapshot(&bam);
+    assert( snap );
+    assert( 0 == bmam_flatten(bmam, 1u << owns, snap) );
+    assert( bam_test_edge(snap, 0, 1) );
+    assert( bam_destroy(snap, 1) );
+    assert( bam_log_attach(&bam, &log) );
+    assert( 0 == bmam_flatten(bmam, 1u << owns, &bam) );
+    assert( bam.log == &log );
+    assert( bam_log_attach(&bam, 0) );
+    assert( bam_destroy(&bam, 0) );
+
+    /* invalid */
+    assert( 0 == bmam_add_edge(bmam, 3, 0, 0) );
+    assert( 0 == bmam_add_edge(bmam, calls, 20, 0) );
+    assert( 0 == bmam_test_edge(bmam, 3, 0, 0) );
+    assert( 0 == bmam_test_edge(bmam, calls, 0, 20) );
+    assert( 0 == bmam_resize(bmam, 10) );
+    assert( 0 == bmam_new(1, 0) );
+    assert( 0 == bmam_new(1, BMAM_MAX_PLANES + 1) );
+    assert( 0 == bmam_size(0) );
+    assert( 0 == bmam_destroy(0, 0) );
+
+    assert( bmam_destroy(bmam, 1) );
+
+    puts("success!");
+}
+
+void fixed(void){
+    struct bitwise_adj_mat *bam = 0;
+    struct bam_fixed_64 small;
+    struct bam_fixed_128 g;
+    struct bam_fixed_128 closure;
+    uint64_t reached[BAM_FIXED_WORDS(128)];
+    uint16_t dist[128];
+    unsigned int n = 100;
+    unsigned int n_reached = 0;
+    unsigned int i = 0;
+    unsigned int j = 0;
+
+    puts("\ntesting fixed size matrices (warnings will be printed)");
+
+    assert( bam_fixed_64_init(&small, 5) );
+    assert( bam_fixed_64_add_edge(&small, 0, 1) );
+    assert( bam_fixed_64_add_edge(&small, 1, 2) );
+    assert( bam_fixed_64_add_edge(&small, 3, 4) );
+    assert( bam_fixed_64_test_edge(&small, 0, 1) );
+    assert( 0 == bam_fixed_64_test_edge(&small, 1, 0) );
+    assert( bam_fixed_64_remove_edge(&small, 3, 4) );
+    assert( 0 == bam_fixed_64_test_edge(&small, 3, 4) );
+
+    assert( 3 == bam_fixed_64_bfs(&small, 0, reached, dist) );
+    assert( reached[0] == 7 );
+    assert( dist[0] == 0 );
+    assert( dist[1] == 1 );
+    assert( dist[2] == 2 );
+    assert( dist[3] == BAM_FIXED_UNREACHABLE );
+
+    bam_fixed_64_closure(&small, &small);
+    assert( bam_fixed_64_test_edge(&small, 0, 2) );
+    assert( 0 == bam_fixed_64_test_edge(&small, 0, 0) );
+    assert( 0 == bam_fixed_64_test_edge(&small, 2, 0) );
+
+    /* invalid */
+    assert( 0 == bam_fixed_64_init(&small, 65) );
+    assert( 0 == bam_fixed_64_add_edge(&small, 5, 0) );
+    assert( 0 == bam_fixed_64_remove_edge(&small, 0, 5) );
+    assert( 0 == bam_fixed_64_test_edge(&small, 5, 0) );
+    assert( 0 == bam_fixed_64_bfs(&small, 5, reached, 0) );
+
+    /* compare against the general matrix across word boundaries */
+    bam = random_graph(n, 130, 5);
+    assert( bam_fixed_128_from_bam(&g, bam) );
+    assert( g.n_nodes == n );
+    for( i=0; i<n; ++i ){
+        for( j=0; j<n; ++j ){
+            assert( bam_fixed_128_test_edge(&g, i, j) == bam_test_edge(bam, i, j) );
+        }
+    }
+
+    bam_fixed_128_closure(&g, &closure);
+    for( i=0; i<n; ++i ){
+        n_reached = bam_fixed_128_bfs(&g, i, reached, dist);
+        assert( n_reached >= 1 );
+        for( j=0; j<n; ++j ){
+            /* reachable by bfs iff in closure, or j is i itself */
+            assert( ((reached[j / 64] >> (j % 64)) & 1) == (i == j || bam_fixed_128_test_edge(&closure, i, j)) );
+            assert( (dist[j] != BAM_FIXED_UNREACHABLE) == ((reached[j / 64] >> (j % 64)) & 1) );
+            if( dist[j] == 1 ){
+                assert( bam_test_edge(bam, i, j) );
+            }
+        }
+    }
+
+    assert( bam_destroy(bam, 1) );
+
+    bam = bam_new(200);
+    assert( bam );
+    assert( 0 == bam_fixed_128_from_bam(&g, bam) );
+    assert( bam_destroy(bam, 1) );
+
+    puts("success!");
+}
+
+void induced_subgraph(void){
+    struct bitwise_adj_mat *bam = 0;
+    struct bitwise_adj_mat *snap = 0;
+    struct bitwise_adj_mat sub;
+    struct bam_log log;
+    uint32_t nodes[150];
+    unsigned int n = 150;
+    unsigned int k = 0;
+    unsigned int i = 0;
+    unsigned int j = 0;
+    unsigned int pass = 0;
+
+    puts("\ntesting induced subgraphs (warnings will be printed)");
+
+    bam = random_graph(n, 2000, 13);
+    assert( bam_init(&sub, 0) );
+
+    for( pass=0; pass<3; ++pass ){
+        k = 0;
+        if( pass == 0 ){
+            /* increasing, spread over every word */
+            for( i=1; i<n; i += 3 ){
+                nodes[k++] = i;
+            }
+        } else if( pass == 1 ){
+            /* arbitrary order */
+            for( i=n; i-- > 0; ){
+                if( i % 4 != 2 ){
+                    nodes[k++] = i;
+                }
+            }
+        } else {
+            /* everything */
+            for( i=0; i<n; ++i ){
+                nodes[k++] = i;
+            }
+        }
+
+        assert( bam_induced_subgraph(bam, nodes, k, &sub) );
+        assert( bam_size(&sub) == k );
+
+        for( i=0; i<k; ++i ){
+            for( j=0; j<k; ++j ){
+                assert( bam_test_edge(&sub, i, j) == bam_test_edge(bam, nodes[i], nodes[j]) );
+            }
+        }
+    }
+
+    /* empty selection */
+    assert( bam_induced_subgraph(bam, nodes, 0, &sub) );
+    assert( bam_size(&sub) == 0 );
+
+    /* snapshots and logged matrices are never replaced */
+    snap = bam_snapshot(&sub);
+    assert( snap );
+    assert( 0 == bam_induced_subgraph(bam, nodes, 1, snap) );
+    assert( bam_destroy(snap, 1) );
+    assert( bam_log_attach(&sub, &log) );
+    assert( 0 == bam_induced_subgraph(bam, nodes, 1, &sub) );
+    assert( bam_log_attach(&sub, 0) );
+
+    /* invalid */
+    nodes[0] = n;
+    assert( 0 == bam_induced_subgraph(bam, nodes, 1, &sub) );
+    assert( 0 == bam_induced_subgraph(bam, 0, 1, &sub) );
+    assert( 0 == bam_induced_subgraph(bam, nodes, 1, bam) );
+    assert( 0 == bam_induced_subgraph(0, nodes, 1, &sub) );
+
+    assert( bam_destroy(&sub, 0) );
+    assert( bam_destroy(bam, 1) );
+
+    puts("success!");
+}
+
+void hops(void){
+    struct bitwise_adj_mat *bam = 0;
+    uint8_t *dist = 0;
+    uint8_t *naive = 0;
+    uint8_t bitset[19];
+    uint64_t reach[150];
+    uint32_t srcs[BAM_KHOP_MAX_SOURCES + 1];
+    unsigned int n = 150;
+    unsigned int n_reached = 0;
+    unsigned int count = 0;
+    unsigned int changed = 0;
+    unsigned int i = 0;
+    unsigned int j = 0;
+    unsigned int k = 0;
+
+    puts("\ntesting k hop neighbourhoods and hop distances (warnings will be printed)");
+
+    bam = random_graph(n, 300, 17);
+
+    /* naive distances by relaxing edge by edge */
+    naive = malloc(n * n);
+    assert( naive );
+    for( i=0; i<n; ++i ){
+        for( j=0; j<n; ++j ){
+            naive[i * n + j] = i == j ? 0 : BAM_HOPS_UNREACHABLE;
+        }
+    }
+    do {
+        changed = 0;
+        for( i=0; i<n; ++i ){
+            for( k=0; k<n; ++k ){
+                if( naive[i * n + k] == BAM_HOPS_UNREACHABLE ){
+                    continue;
+                }
+                for( j=0; j<n; ++j ){
+                    if( bam_test_edge(bam, k, j) && naive[i * n + k] + 1 < naive[i * n + j] ){
+                        naive[i * n + j] = naive[i * n + k] + 1;
+                        changed = 1;
+                    }
+                }
+            }
+        }
+    } while( changed );
+
+    dist = malloc(n * n);
+    assert( dist );
+    assert( bam_apsp_hops(bam, dist) );
+    for( i=0; i<n*n; ++i ){
+        assert( dist[i] == naive[i] );
+    }
+
+    for( k=0; k<5; ++k ){
+        /* single source */
+        for( i=0; i<n; i += 7 ){
+            n_reached = bam_khop(bam, i, k, bitset);
+            count = 0;
+            for( j=0; j<n; ++j ){
+                assert( ((bitset[j / 8] >> (j % 8)) & 1) == (naive[i * n + j] <= k) );
+                count += naive[i * n + j] <= k;
+            }
+            assert( n_reached == count );
+        }
+
+        /* 64 sources at a time */
+        for( i=0; i<BAM_KHOP_MAX_SOURCES; ++i ){
+            srcs[i] = (i * 37) % n;
+        }
+        assert( bam_khop_multi(bam, srcs, BAM_KHOP_MAX_SOURCES, k, reach) );
+        for( i=0; i<BAM_KHOP_MAX_SOURCES; ++i ){
+            for( j=0; j<n; ++j ){
+                assert( ((reach[j] >> i) & 1) == (naive[srcs[i] * n + j] <= k) );
+            }
+        }
+    }
+
+    /* invalid */
+    assert( 0 == bam_khop(bam, n, 1, bitset) );
+    assert( 0 == bam_khop(bam, 0, 1, 0) );
+    assert( 0 == bam_khop_multi(bam, srcs, BAM_KHOP_MAX_SOURCES + 1, 1, reach) );
+    srcs[0] = n;
+    assert( 0 == bam_khop_multi(bam, srcs, 1, 1, reach) );
+    assert( 0 == bam_apsp_hops(bam, 0) );
+    assert( 0 == bam_apsp_hops(0, dist) );
+
+    free(dist);
+    free(naive);
+    assert( bam_destroy(bam, 1) );
+
+    puts("success!");
+}
+
+/* bam_numa_run callback counting edges in rows [begin, end) into the
+ * counter of the node owning them, so no two threads share a counter
+ */
+void count_row_edges(struct bitwise_adj_mat *bam, unsigned int begin, unsigned int end, void *arg){
+    unsigned int *counts = arg;
+    unsigned int count = 0;
+    unsigned int node = 0;
+    unsigned int node_begin = 0;
+    unsigned int node_end = 0;
+    unsigned int i = 0;
+
+    for( i = begin * bam->n_cols; i < end * bam->n_cols; ++i ){
+        count += __builtin_popcount(bam->cells[i]);
+    }
+
+    /* only empty ranges can be repeated and they have nothing to count */
+    for( node=0; node < bam_numa_nodes() && begin < end; ++node ){
+        bam_numa_rows(bam, node, &node_begin, &node_end);
+        if( node_begin == begin && node_end == end ){
+            counts[node] = count;
+        }
+    }
+}
+
+void shm(void){
+    struct bitwise_adj_mat writer;
+    struct bitwise_adj_mat reader;
+    const char *name = "/test_bam_shm";
+    unsigned int begin = 0;
+    unsigned int end = 0;
+    unsigned int node = 0;
+    unsigned int next_begin = 0;
+    unsigned int count = 0;
+    unsigned int *counts = 0;
+    uint8_t bitset[125];
+
+    puts("\ntesting shared memory matrices (warnings will be printed)");
+
+    /* in case a previous run died */
+    bam_shm_unlink(name);
+
+    assert( bam_shm_create(&writer, name, 1000, BAM_NUMA_PARTITION) );
+    assert( bam_size(&writer) == 1000 );
+    assert( bam_shm_numa_policy(&writer) == BAM_NUMA_PARTITION );
+
+    /* already exists */
+    assert( 0 == bam_shm_create(&reader, name, 10, BAM_NUMA_NONE) );
+
+    assert( bam_shm_attach(&reader, name) );
+    assert( bam_size(&reader) == 1000 );
+    assert( reader.cells != writer.cells );
+    assert( bam_shm_numa_policy(&reader) == BAM_NUMA_PARTITION );
+
+    /* writes through one mapping are seen through the other */
+    assert( bam_add_edge(&writer, 0, 999) );
+    assert( bam_add_edge(&writer, 500, 3) );
+    assert( bam_test_edge(&reader, 0, 999) );
+    assert( bam_test_edge(&reader, 500, 3) );
+    assert( bam_remove_edge(&reader, 0, 999) );
+    assert( 0 == bam_test_edge(&writer, 0, 999) );
+    assert( bam_add_edge(&reader, 7, 7) );
+
+    /* segments cannot grow, be snapshotted or freed */
+    assert( 0 == bam_resize(&writer, 2000) );
+    assert( 0 == bam_snapshot(&writer) );
+    assert( 0 == bam_destroy(&writer, 0) );
+
+    /* rows are split between nodes without gaps or overlap */
+    assert( bam_numa_nodes() >= 1 );
+    for( node=0; node < bam_numa_nodes(); ++node ){
+        assert( bam_numa_rows(&writer, node, &begin, &end) );
+        assert( begin == next_begin );
+        assert( begin <= end );
+        next_begin = end;
+    }
+    assert( next_begin == 1000 );
+    assert( 0 == bam_numa_rows(&writer, bam_numa_nodes(), &begin, &end) );
+
+    /* as would be split on a four node machine, 125 cells per row and
+     * 125000 cells in total means each node starts on the first whole
+     * row within its pages
+     */
+    assert( bam_numa_first_row(1000, 125, 0, 4) == 0 );
+    for( node=1; node < 4; ++node ){
+        begin = bam_numa_first_row(1000, 125, node, 4);
+        assert( begin > bam_numa_first_row(1000, 125, node - 1, 4) );
+        assert( (begin * 125) % 4096 < 125 );
+    }
+    assert( bam_numa_first_row(1000, 125, 4, 4) == 1000 );
+
+    counts = calloc(bam_numa_nodes(), sizeof(unsigned int));
+    assert( counts );
+    assert( bam_numa_run(&reader, count_row_edges, counts) );
+    for( node=0; node < bam_numa_nodes(); ++node ){
+        count += counts[node];
+    }
+    assert( count == 2 );
+    free(counts);
+
+    /* algorithms split their rows the same way, 500 -> 3 and 7 -> 7 */
+    assert( bam_khop(&reader, 500, 1, bitset) == 2 );
+    assert( bitset[500 / 8] & (1 << (500 % 8)) );
+    assert( bitset[3 / 8] & (1 << (3 % 8)) );
+    assert( bam_khop(&reader, 7, 5, bitset) == 1 );
+
+    assert( bam_shm_detach(&reader) );
+    assert( 0 == bam_shm_detach(&reader) );
+
+    /* segment outlives every mapping until unlinked */
+    assert( bam_shm_detach(&writer) );
+    assert( bam_shm_attach(&reader, name) );
+    assert( bam_test_edge(&reader, 500, 3) );
+    assert( bam_test_edge(&reader, 7, 7) );
+    assert( bam_shm_detach(&reader) );
+
+    assert( bam_shm_unlink(name) );
+    assert( 0 == bam_shm_attach(&reader, name) );
+    assert( 0 == bam_shm_unlink(name) );
+
+    assert( 0 == bam_shm_create(&writer, name, 0, BAM_NUMA_NONE) );
+    assert( 0 == bam_shm_create(&writer, name, 10, 3) );
+    assert( 0 == bam_shm_create(0, name, 10, BAM_NUMA_NONE) );
+
+    puts("success!");
+}
+
+void hybrid(void){
+    struct bitwise_hybrid_adj_mat *bham = 0;
+    struct bitwise_adj_mat *bam = 0;
+    struct bitwise_adj_mat *snap = 0;
+    struct bitwise_adj_mat copy;
+    struct bam_log log;
+    uint8_t bitset[38];
+    unsigned int n = 300;
+    unsigned int i = 0;
+    unsigned int j = 0;
+    unsigned int count = 0;
+
+    puts("\ntesting hybrid sparse and dense matrices (warnings will be printed)");
+
+    bham = bham_new(n);
+    assert( bham );
+    assert( bham_size(bham) == n );
+    assert( bham->n_cols == 38 );
+
+    /* sparse until ids would outgrow 38 cells, so 9 or fewer edges */
+    for( i=0; i<9; ++i ){
+        assert( bham_add_edge(bham, i * 31, 5) );
+    }
+    assert( bham->rows[5].kind == BHAM_ROW_SPARSE );
+    assert( bham->rows[5].n_edges == 9 );
+
+    /* adding an existing edge changes nothing */
+    assert( bham_add_edge(bham, 0, 5) );
+    assert( bham->rows[5].n_edges == 9 );
+
+    assert( bham_add_edge(bham, 299, 5) );
+    assert( bham->rows[5].kind == BHAM_ROW_DENSE );
+    assert( bham->rows[5].n_edges == 10 );
+
+    for( i=0; i<n; ++i ){
+        assert( bham_test_edge(bham, i, 5) == (i == 299 || (i % 31 == 0 && i < 9 * 31)) );
+    }
+
+    /* back to sparse once below half the threshold, fewer than 5 edges */
+    for( i=0; i<6; ++i ){
+        assert( bham_remove_edge(bham, i * 31, 5) );
+    }
+    assert( bham->rows[5].kind == BHAM_ROW_SPARSE );
+    assert( bham->rows[5].n_edges == 4 );
+    assert( bham_test_edge(bham, 6 * 31, 5) );
+    assert( bham_test_edge(bham, 299, 5) );
+    assert( 0 == bham_test_edge(bham, 0, 5) );
+
+    /* iterate in order */
+    j = 0;
+    for( i = bham_next_edge(bham, 0, 5); i < bham_size(bham); i = bham_next_edge(bham, i + 1, 5) ){
+        assert( i > j || j == 0 );
+        j = i;
+        ++count;
+    }
+    assert( count == 4 );
+    assert( bham_destroy(bham, 1) );
+
+    /* compare with a bitwise_adj_mat, mixing sparse and dense rows */
+    bam = random_graph(n, 3000, 23);
+    bham = bham_new(n);
+    assert( bham );
+    for( i=0; i<n; ++i ){
+        for( j=0; j<n; ++j ){
+            if( bam_test_edge(bam, i, j) ){
+                assert( bham_add_edge(bham, i, j) );
+            }
+        }
+    }
+    /* a few very busy rows */
+    for( i=0; i<n; i += 2 ){
+        assert( bam_add_edge(bam, i, 7) );
+        assert( bham_add_edge(bham, i, 7) );
+        assert( bam_add_edge(bam, i, 250) );
+        assert( bham_add_edge(bham, i, 250) );
+    }
+    assert( bham->rows[7].kind == BHAM_ROW_DENSE );
+    assert( bham->rows[8].kind == BHAM_ROW_SPARSE );
+
+    assert( bam_init(&copy, 0) );
+
+    /* never into a snapshot or a logged matrix */
+    snap = bam_snapshot(&copy);
+    assert( snap );
+    assert( 0 == bham_to_bam(bham, snap) );
+    assert( bam_size(snap) == 0 );
+    assert( bam_destroy(snap, 1) );
+    assert( bam_log_attach(&copy, &log) );
+    assert( 0 == bham_to_bam(bham, &copy) );
+    assert( bam_log_attach(&copy, 0) );
+
+    assert( bham_to_bam(bham, &copy) );
+
+    memset(bitset, 0, sizeof(bitset));
+    for( i=0; i<n; i += 3 ){
+        bitset[i / 8] |= 1 << (i % 8);
+    }
+
+    for( j=0; j<n; ++j ){
+        count = 0;
+        for( i=0; i<n; ++i ){
+            assert( bham_test_edge(bham, i, j) == bam_test_edge(bam, i, j) );
+            assert( bam_test_edge(&copy, i, j) == bam_test_edge(bam, i, j) );
+            if( bam_test_edge(bam, i, j) && i % 3 == 0 ){
+                ++count;
+            }
+        }
+        assert( bham_row_and_count(bham, j, bitset) == count );
+
+        /* next_edge visits exactly the edges into j */
+        i = bham_next_edge(bham, 0, j);
+        for( count=0; count<n; ++count ){
+            if( bam_test_edge(bam, count, j) ){
+                assert( i == count );
+                i = bham_next_edge(bham, i + 1, j);
+            }
+        }
+        assert( i == n );
+    }
+
+    /* growing keeps every row */
+    assert( bham_resize(bham, 1000) );
+    assert( bham->n_cols == 125 );
+    for( j=0; j<n; ++j ){
+        for( i=0; i<n; ++i ){
+            assert( bham_test_edge(bham, i, j) == bam_test_edge(bam, i, j) );
+        }
+    }
+    assert( bham_add_edge(bham, 999, 7) );
+    assert( bham_test_edge(bham, 999, 7) );
+    assert( bham_add_edge(bham, 999, 998) );
+    assert( bham_test_edge(bham, 999, 998) );
+
+    /* invalid */
+    assert( 0 == bham_add_edge(bham, 1000, 0) );
+    assert( 0 == bham_remove_edge(bham, 0, 1000) );
+    assert( 0 == bham_test_edge(bham, 1000, 0) );
+    assert( 0 == bham_resize(bham, 10) );
+    assert( 0 == bham_row_or(bham, 0, 0) );
+    assert( 0 == bham_size(0) );
+    assert( 0 == bham_init(0, 0) );
+
+    assert( bam_destroy(&copy, 0) );
+    assert( bam_destroy(bam, 1) );
+    assert( bham_destroy(bham, 1) );
+
+    puts("success!");
+}
+
 int main(void){
     simple();
 
@@ -309,6 +1477,28 @@ int main(void){
 
     internal();
 
+    snapshot();
+
+    logging();
+
+    scc();
+
+    toposort();
+
+    connected_components();
+
+    multi();
+
+    fixed();
+
+    induced_subgraph();
+
+    hops();
+
+    shm();
+
+    hybrid();
+
     puts("\noverall testing success!");
 
     return 0;
@@ -0,0 +1,348 @@
+/*  g++ -std=c++17 bitwise_adj_mat*.o test_bitwise_adj_mat_hpp.cpp -Wall -Wextra -Werror -o test_bam_hpp
+ * ./test_bam_hpp
+ */
+#include <assert.h> /* assert */
+#include <stdio.h> /* puts, remove */
+
+#include <algorithm> /* count_if, find */
+#include <iterator> /* distance */
+#include <stdexcept> /* invalid_argument */
+#include <type_traits> /* is_copy_constructible */
+#include <utility> /* move */
+#include <vector> /* vector */
+
+#include "bitwise_adj_mat.hpp"
+#include "bitwise_adj_mat_log.h"
+
+void lifetime(void);
+void accessors(void);
+void neighbors(void);
+void expressions(void);
+void logged(void);
+
+void lifetime(void){
+    bam::matrix empty;
+    bam::matrix a(20);
+    bam::matrix b;
+    bam::matrix c;
+    const uint8_t *cells = 0;
+
+    puts("\ntesting C++ wrapper lifetime");
+
+    static_assert( ! std::is_copy_constructible<bam::matrix>::value, "matrix must be move only" );
+    static_assert( ! std::is_copy_assignable<bam::matrix>::value, "matrix must be move only" );
+    static_assert( std::is_nothrow_move_constructible<bam::matrix>::value, "moves must not throw" );
+    static_assert( std::is_nothrow_move_assignable<bam::matrix>::value, "moves must not throw" );
+
+    assert( empty.size() == 0 );
+    assert( a.size() == 20 );
+    assert( a.get()->n_cols == 3 );
+
+    assert( a.set(3, 7) );
+    cells = a.get()->cells;
+
+    /* moving hands over the cells rather than copying them */
+    b = std::move(a);
+    assert( b.get()->cells == cells );
+    assert( b.size() == 20 );
+    assert( a.size() == 0 );
+    assert( a.get()->cells == 0 );
+    assert( b.test(3, 7) );
+
+    /* clone is a deep copy */
+    c = b.clone();
+    assert( c.size() == 20 );
+    assert( c.get()->cells != b.get()->cells );
+    assert( c.test(3, 7) );
+    assert( c.reset(3, 7) );
+    assert( ! c.test(3, 7) );
+    assert( b.test(3, 7) );
+
+    /* resize keeps edges */
+    b.resize(100);
+    assert( b.size() == 100 );
+    assert( b.test(3, 7) );
+    b.resize(100);
+    assert( b.size() == 100 );
+
+    /* resize from empty */
+    empty.resize(5);
+    assert( empty.size() == 5 );
+
+    puts("success!");
+}
+
+void accessors(void){
+    bam::matrix m(70);
+    struct bitwise_adj_mat *snap = 0;
+    unsigned int i = 0;
+    unsigned int j = 0;
+
+    puts("\ntesting C++ wrapper accessors");
+
+    static_assert( noexcept(m.test(0, 0)), "test must be noexcept" );
+    static_assert( noexcept(m.set(0, 0)), "set must be noexcept" );
+
+    for( i=0; i<70; ++i ){
+        assert( m.set(i, (i * 7) % 70) );
+    }
+
+    /* agrees with the C API */
+    for( i=0; i<70; ++i ){
+        for( j=0; j<70; ++j ){
+            assert( m.test(i, j) == (j == (i * 7) % 70) );
+            assert( m.test(i, j) == (1 == bam_test_edge(m.get(), i, j)) );
+        }
+    }
+
+    assert( m.set(69, 69, false) == true );
+    assert( ! m.test(69, 69) );
+    assert( bam_add_edge(m.get(), 69, 69) );
+    assert( m.test(69, 69) );
+
+    /* with a snapshot taken through the C API writes must not reach it */
+    snap = bam_snapshot(m.get());
+    assert( snap );
+    assert( m.set(1, 2) );
+    assert( m.test(1, 2) );
+    assert( ! bam_test_edge(snap, 1, 2) );
+    assert( bam_test_edge(snap, 0, 0) );
+    assert( bam_destroy(snap, 1) );
+
+    puts("success!");
+}
+
+void neighbors(void){
+    bam::matrix m(130);
+    std::vector<unsigned int> nodes;
+    unsigned int i = 0;
+    unsigned int count = 0;
+
+    puts("\ntesting C++ wrapper neighbor ranges");
+
+    /* 5 -> 0, 5 -> 63, 5 -> 64, 5 -> 129 */
+    assert( m.set(5, 0) );
+    assert( m.set(5, 63) );
+    assert( m.set(5, 64) );
+    assert( m.set(5, 129) );
+
+    /* 0 -> 9, 7 -> 9, 63 -> 9, 64 -> 9, 100 -> 9, 129 -> 9 */
+    assert( m.set(0, 9) );
+    assert( m.set(7, 9) );
+    assert( m.set(63, 9) );
+    assert( m.set(64, 9) );
+    assert( m.set(100, 9) );
+    assert( m.set(129, 9) );
+
+    for( unsigned int v : m.out_neighbors(5) ){
+        nodes.push_back(v);
+    }
+    assert( nodes == (std::vector<unsigned int>{0, 63, 64, 129}) );
+
+    nodes.clear();
+    for( unsigned int v : m.in_neighbors(9) ){
+        nodes.push_back(v);
+    }
+    assert( nodes == (std::vector<unsigned int>{0, 7, 63, 64, 100, 129}) );
+
+    /* usable with STL algorithms */
+    assert( std::distance(m.in_neighbors(9).begin(), m.in_neighbors(9).end()) == 6 );
+    assert( std::find(m.in_neighbors(9).begin(), m.in_neighbors(9).end(), 100u) != m.in_neighbors(9).end() );
+    assert( std::count_if(m.out_neighbors(5).begin(), m.out_neighbors(5).end(), [](unsigned int v){ return v > 60; }) == 3 );
+
+    /* empty ranges */
+    assert( m.in_neighbors(1).begin() == m.in_neighbors(1).end() );
+    assert( m.out_neighbors(0).begin() != m.out_neighbors(0).end() );
+    assert( m.out_neighbors(1).begin() == m.out_neighbors(1).end() );
+
+    /* every in neighbor of every node, compared against test */
+    for( i=0; i<130; ++i ){
+        for( unsigned int v : m.in_neighbors(i) ){
+            assert( m.test(v, i) );
+            ++count;
+        }
+    }
+    assert( count == 10 );
+
+    puts("success!");
+}
+
+void expressions(void){
+    bam::matrix a(40);
+    bam::matrix b(40);
+    bam::matrix c(40);
+    bam::matrix d;
+    bam::matrix small(10);
+    unsigned int i = 0;
+    unsigned int j = 0;
+    bool threw = false;
+
+    puts("\ntesting C++ wrapper expressions");
+
+    for( i=0; i<40; ++i ){
+        for( j=0; j<40; ++j ){
+            a.set(i, j, (i + j) % 2);
+            b.set(i, j, i % 3 == 0);
+            c.set(i, j, j % 5 == 0);
+        }
+    }
+
+    /* fused into one pass, evaluated into a new matrix */
+    d = (a & b) | c;
+    assert( d.size() == 40 );
+    for( i=0; i<40; ++i ){
+        for( j=0; j<40; ++j ){
+            assert( d.test(i, j) == ((a.test(i, j) && b.test(i, j)) || c.test(i, j)) );
+        }
+    }
+
+    /* an expression may be kept and evaluated later */
+    auto e = (a ^ b) - c;
+    bam::matrix f(e);
+    for( i=0; i<40; ++i ){
+        for( j=0; j<40; ++j ){
+            assert( f.test(i, j) == ((a.test(i, j) != b.test(i, j)) && ! c.test(i, j)) );
+        }
+    }
+
+    /* in place, the target may appear in the expression */
+    d = d & a;
+    for( i=0; i<40; ++i ){
+        for( j=0; j<40; ++j ){
+            assert( d.test(i, j) == (((a.test(i, j) && b.test(i, j)) || c.test(i, j)) && a.test(i, j)) );
+        }
+    }
+
+    d |= b;
+    d -= c;
+    d ^= a;
+    d &= b;
+    for( i=0; i<40; ++i ){
+        for( j=0; j<40; ++j ){
+            assert( d.test(i, j) == (b.test(i, j) && (! c.test(i, j) != a.test(i, j))) );
+        }
+    }
+
+    /* assigning to a matrix of another size replaces it */
+    small = a | b;
+    assert( small.size() == 40 );
+    assert( small.test(0, 0) );
+
+    /* operands must match */
+    small.resize(50);
+    try {
+        d = a & small;
+    } catch( const std::invalid_argument & ){
+        threw = true;
+    }
+    assert( threw );
+
+    puts("success!");
+}
+
+void logged(void){
+    const char *image_path = "test_bam_hpp.image";
+    const char *log_path = "test_bam_hpp.log";
+    struct bam_log log;
+    struct bitwise_adj_mat *snap = 0;
+    bam::matrix a(40);
+    bam::matrix b(40);
+    bam::matrix c(40);
+    bam::matrix big(60);
+    bam::matrix none(60);
+    bam::matrix replica;
+    struct bam_log_pos pos = {0, 0};
+    unsigned int i = 0;
+    unsigned int j = 0;
+    bool threw = false;
+
+    puts("\ntesting C++ wrapper expressions with a log attached");
+
+    remove(image_path);
+    remove(log_path);
+
+    for( i=0; i<40; ++i ){
+        b.set(i, (i * 7) % 40, i % 3 == 0);
+        c.set(i, (i * 7) % 40, i % 2 == 0);
+        c.set(i, (i + 1) % 40);
+    }
+    a.set(0, 1);
+    a.set(6, 2);
+    assert( big.set(59, 50) );
+
+    assert( bam_save(a.get(), image_path) );
+    assert( bam_log_open(&log, log_path) );
+    assert( bam_log_attach(a.get(), &log) );
+
+    assert( a.set(5, 6) );
+    a |= b;
+    a = a - c;
+    a ^= b;
+    assert( a.test(6, 2) );
+    assert( ! a.test(0, 1) );
+    assert( ! a.test(3, 21) );
+
+    /* with a snapshot the cells are in chunks, the log must survive */
+    snap = bam_snapshot(a.get());
+    assert( snap );
+    a |= c;
+    assert( a.get()->log == &log );
+    assert( a.test(0, 1) );
+    assert( ! bam_test_edge(snap, 0, 1) );
+    assert( bam_destroy(snap, 1) );
+
+    /* image plus log is the same matrix */
+    assert( bam_log_commit(&log) );
+    assert( bam_load(replica.get(), image_path) );
+    assert( bam_replay_log(replica.get(), log_path, &pos) );
+    for( i=0; i<40; ++i ){
+        for( j=0; j<40; ++j ){
+            assert( replica.test(i, j) == a.test(i, j) );
+        }
+    }
+
+    /* grows in place so the resize is logged too, and cannot shrink */
+    a = big | none;
+    assert( a.get()->log == &log );
+    assert( a.size() == 60 );
+    try {
+        a = b | c;
+    } catch( const std::invalid_argument & ){
+        threw = true;
+    }
+    assert( threw );
+    assert( a.size() == 60 );
+
+    assert( bam_log_commit(&log) );
+    assert( bam_replay_log(replica.get(), log_path, &pos) );
+    assert( replica.size() == 60 );
+    for( i=0; i<60; ++i ){
+        for( j=0; j<60; ++j ){
+            assert( replica.test(i, j) == (i == 59 && j == 50) );
+        }
+    }
+
+    assert( bam_log_attach(a.get(), 0) );
+    assert( bam_log_close(&log) );
+
+    remove(image_path);
+    remove(log_path);
+
+    puts("success!");
+}
+
+int main(void){
+    lifetime();
+
+    accessors();
+
+    neighbors();
+
+    expressions();
+
+    logged();
+
+    puts("\noverall testing success!");
+
+    return 0;
+}